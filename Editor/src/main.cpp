@@ -1,9 +1,47 @@
 #include <Crow/Log.hpp>
+#include <Crow/ShaderArchive.hpp>
+#include <Crow/ShaderCache.hpp>
+#include <Crow/ShaderHotReload.hpp>
+#include <Crow/ShaderModule.hpp>
+#include <Crow/ShaderPermutation.hpp>
 #include <Crow/Window.hpp>
 
 #include <Crow/Renderer.hpp>
 
+#include <filesystem>
+#include <string_view>
+#include <unordered_map>
+
+#ifdef CROW_NO_SHADERC
+// Built by crowshaderc from the shader directory and the variant manifest
+constexpr auto shader_archive_path = "shaders.crsa";
+#else
+// Variants used while editing, crowshaderc -m precompiles them for shipping
+constexpr auto shader_variants_path = "cache/shader_variants.txt";
+#endif
+
 int main() {
+#ifdef CROW_NO_SHADERC
+    if (!crow::shader_archive.Open(shader_archive_path)) {
+        crow::println("Failed to open shader archive");
+        return -1;
+    }
+#else
+    crow::shader_cache.Open("cache/shaders");
+
+    // Keep the variants of earlier sessions that this one never requests
+    auto records = std::filesystem::exists(shader_variants_path)
+                       ? crow::ShaderVariantManifest::Read(shader_variants_path)
+                       : std::nullopt;
+
+    if (records) {
+        for (auto& record : records.value()) {
+            crow::shader_variant_manifest.Record(record.file_name,
+                                                 record.stage, record.defines);
+        }
+    }
+#endif
+
     crow::WindowBuilder builder;
 
     auto window_ret =
@@ -16,13 +54,40 @@ int main() {
 
     auto window = std::move(window_ret.value());
 
+#ifdef CROW_NO_SHADERC
+    // Every module is created up front, released before the window goes
+    std::unordered_map<std::string_view, crow::ShaderModuleRef> shaders;
+
+    for (auto name : crow::shader_archive.GetNames()) {
+        auto module = crow::shader_module_registry.Acquire(
+            crow::shader_archive.Find(name).value());
+
+        if (!module) {
+            crow::println("Failed to create shader {}", name);
+            return -1;
+        }
+
+        shaders.emplace(name, std::move(module.value()));
+    }
+
+    crow::println("Loaded {} shaders", shaders.size());
+#else
+    crow::shader_hot_reloader.Start();
+#endif
+
     while (!window.ShouldClose()) {
         window.Update();
 
-        crow::renderer.StartFrame();
+        if (!crow::renderer.StartFrame()) {
+            continue;
+        }
 
         // Draw here
 
         crow::renderer.SubmitFrame();
     }
+
+#ifndef CROW_NO_SHADERC
+    crow::shader_variant_manifest.Write(shader_variants_path);
+#endif
 }
\ No newline at end of file
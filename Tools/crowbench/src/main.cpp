@@ -0,0 +1,383 @@
+#include <Crow/Log.hpp>
+#include <Crow/Shader.hpp>
+#include <Crow/ShaderCache.hpp>
+#include <Crow/ShaderInclude.hpp>
+#include <Crow/ThreadPool.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct BenchShader {
+    std::string file_name;
+    std::string code;
+    VkShaderStageFlagBits stage;
+    std::string include_path;
+};
+
+// Used when no shader directory is given so the benchmark always has
+// something to compile
+const BenchShader builtin_shaders[] = {
+    {"builtin.vert",
+     "#version 450\n"
+     "layout(location = 0) in vec3 position;\n"
+     "layout(location = 1) in vec2 uv;\n"
+     "layout(location = 0) out vec2 out_uv;\n"
+     "layout(set = 0, binding = 0) uniform Camera { mat4 view_proj; };\n"
+     "void main() {\n"
+     "    out_uv = uv;\n"
+     "    gl_Position = view_proj * vec4(position, 1.0);\n"
+     "}\n",
+     VK_SHADER_STAGE_VERTEX_BIT, ""},
+    {"builtin.frag",
+     "#version 450\n"
+     "layout(location = 0) in vec2 uv;\n"
+     "layout(location = 0) out vec4 color;\n"
+     "layout(set = 0, binding = 1) uniform sampler2D albedo;\n"
+     "void main() {\n"
+     "    vec4 sum = vec4(0.0);\n"
+     "    for (int i = 0; i < 8; i++) {\n"
+     "        sum += texture(albedo, uv + vec2(i) * 0.001);\n"
+     "    }\n"
+     "    color = sum / 8.0;\n"
+     "}\n",
+     VK_SHADER_STAGE_FRAGMENT_BIT, ""},
+    {"builtin.comp",
+     "#version 450\n"
+     "layout(local_size_x = 64) in;\n"
+     "layout(set = 0, binding = 0) buffer Data { float values[]; };\n"
+     "void main() {\n"
+     "    uint i = gl_GlobalInvocationID.x;\n"
+     "    values[i] = sqrt(values[i]) * 2.0;\n"
+     "}\n",
+     VK_SHADER_STAGE_COMPUTE_BIT, ""},
+};
+
+constexpr crow::ShaderOptimization optimizations[] = {
+    crow::ShaderOptimization::Zero, crow::ShaderOptimization::Size,
+    crow::ShaderOptimization::Performance};
+
+std::string_view GetOptimizationName(crow::ShaderOptimization optimization) {
+    switch (optimization) {
+    case crow::ShaderOptimization::Zero:
+        return "zero";
+    case crow::ShaderOptimization::Size:
+        return "size";
+    case crow::ShaderOptimization::Performance:
+        return "performance";
+    }
+    return "unknown";
+}
+
+std::string_view GetStageName(VkShaderStageFlagBits stage) {
+    switch (stage) {
+    case VK_SHADER_STAGE_VERTEX_BIT:
+        return "vertex";
+    case VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT:
+        return "tessellation_control";
+    case VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT:
+        return "tessellation_evaluation";
+    case VK_SHADER_STAGE_GEOMETRY_BIT:
+        return "geometry";
+    case VK_SHADER_STAGE_FRAGMENT_BIT:
+        return "fragment";
+    case VK_SHADER_STAGE_COMPUTE_BIT:
+        return "compute";
+    case VK_SHADER_STAGE_TASK_BIT_EXT:
+        return "task";
+    case VK_SHADER_STAGE_MESH_BIT_EXT:
+        return "mesh";
+    default:
+        return "ray_tracing";
+    }
+}
+
+std::string EscapeJson(std::string_view str) {
+    std::string escaped;
+    for (auto c : str) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+double ToMilliseconds(Clock::duration duration) {
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+struct Timing {
+    double median_ms;
+    double min_ms;
+};
+
+Timing Summarize(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    return {samples[samples.size() / 2], samples.front()};
+}
+
+template <typename F>
+Timing Measure(size_t iterations, F&& func) {
+    std::vector<double> samples;
+    samples.reserve(iterations);
+
+    for (size_t i = 0; i < iterations; i++) {
+        auto start = Clock::now();
+        func();
+        samples.push_back(ToMilliseconds(Clock::now() - start));
+    }
+
+    return Summarize(std::move(samples));
+}
+
+std::vector<uint32_t> Compile(const crow::ShaderCompiler& compiler,
+                              const BenchShader& shader,
+                              crow::ShaderOptimization optimization) {
+    crow::ShaderCompileSettings settings{};
+    settings.optimization = optimization;
+
+    return compiler.Compile(shader.file_name, shader.code, shader.stage,
+                            shader.include_path, settings);
+}
+
+std::string FormatTiming(const Timing& timing) {
+    return std::format("{{\"median_ms\": {:.4f}, \"min_ms\": {:.4f}}}",
+                       timing.median_ms, timing.min_ms);
+}
+
+void PrintUsage() {
+    std::cerr << "Usage: crowbench [options] [shader directory]\n"
+                 "  -I <directory>  Add an include directory\n"
+                 "  -n <count>      Iterations per measurement (default 10)\n"
+                 "  -o <file>       JSON output (default bench.json)\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t iterations = 10;
+    std::filesystem::path output_path = "bench.json";
+    std::filesystem::path shader_directory;
+
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+
+        if (arg == "-I" && i + 1 < argc) {
+            crow::shader_includer.AddIncludeDirectory(argv[++i]);
+        } else if (arg == "-n" && i + 1 < argc) {
+            std::string_view count = argv[++i];
+
+            auto [ptr, err] = std::from_chars(
+                count.data(), count.data() + count.size(), iterations);
+            if (err != std::errc() || ptr != count.data() + count.size()) {
+                crow::println("Invalid iteration count {}", count);
+                PrintUsage();
+                return -1;
+            }
+
+            iterations = std::max(iterations, size_t(1));
+        } else if (arg == "-o" && i + 1 < argc) {
+            output_path = argv[++i];
+        } else if (arg.starts_with("-") || !shader_directory.empty()) {
+            PrintUsage();
+            return -1;
+        } else {
+            shader_directory = arg;
+        }
+    }
+
+    std::vector<BenchShader> shaders;
+
+    if (shader_directory.empty()) {
+        shaders.assign(std::begin(builtin_shaders), std::end(builtin_shaders));
+    } else {
+        std::error_code ec;
+        for (auto& file : std::filesystem::recursive_directory_iterator(
+                 shader_directory, ec)) {
+            auto stage = crow::GetShaderStageFromPath(file.path());
+            if (!file.is_regular_file() || !stage) {
+                continue;
+            }
+
+            std::ifstream stream(file.path(), std::ios::binary);
+            std::string code{std::istreambuf_iterator<char>(stream),
+                             std::istreambuf_iterator<char>()};
+
+            shaders.push_back({file.path().generic_string(), std::move(code),
+                               stage.value(),
+                               shader_directory.generic_string()});
+        }
+
+        if (ec || shaders.empty()) {
+            std::cerr << "No shaders found in " << shader_directory.string()
+                      << "\n";
+            return -1;
+        }
+    }
+
+    // Every measurement except the cache hits runs with the cache closed so
+    // that it times the compiler and nothing else
+    crow::shader_cache.Close();
+
+    std::string results;
+
+    // Built once like the engine does, the option templates are not part of
+    // what a compile costs
+    crow::ShaderCompiler cold_compiler;
+
+    for (auto& shader : shaders) {
+        for (auto optimization : optimizations) {
+            // Each cold compile is the first one on a new thread, so it pays
+            // for that thread's shaderc compiler. Starting the thread is not
+            // timed
+            std::vector<double> cold_samples(iterations);
+            for (auto& sample : cold_samples) {
+                std::thread([&]() {
+                    auto start = Clock::now();
+                    Compile(cold_compiler, shader, optimization);
+                    sample = ToMilliseconds(Clock::now() - start);
+                }).join();
+            }
+
+            auto cold = Summarize(std::move(cold_samples));
+
+            if (Compile(crow::shader_compiler, shader, optimization).empty()) {
+                std::cerr << "Could not compile " << shader.file_name << "\n";
+                return -1;
+            }
+
+            auto reused = Measure(iterations, [&]() {
+                Compile(crow::shader_compiler, shader, optimization);
+            });
+
+            if (!results.empty()) {
+                results += ",\n";
+            }
+
+            results += std::format(
+                "    {{\"shader\": \"{}\", \"stage\": \"{}\", "
+                "\"optimization\": \"{}\", \"cold\": {}, \"reused\": {}}}",
+                EscapeJson(shader.file_name), GetStageName(shader.stage),
+                GetOptimizationName(optimization), FormatTiming(cold),
+                FormatTiming(reused));
+
+            std::cout << std::format("{} {}: cold {:.2f} ms, reused {:.2f} ms",
+                                     shader.file_name,
+                                     GetOptimizationName(optimization),
+                                     cold.median_ms, reused.median_ms)
+                      << "\n";
+        }
+    }
+
+    auto cache_directory =
+        std::filesystem::temp_directory_path() / "crowbench_cache";
+
+    std::string cache_results;
+
+    if (crow::shader_cache.Open(cache_directory)) {
+        crow::shader_cache.Clear();
+
+        for (auto& shader : shaders) {
+            // Fills the cache entry
+            Compile(crow::shader_compiler, shader,
+                    crow::ShaderOptimization::Performance);
+
+            auto hit = Measure(iterations, [&]() {
+                Compile(crow::shader_compiler, shader,
+                        crow::ShaderOptimization::Performance);
+            });
+
+            if (!cache_results.empty()) {
+                cache_results += ",\n";
+            }
+
+            cache_results +=
+                std::format("    {{\"shader\": \"{}\", \"hit\": {}}}",
+                            EscapeJson(shader.file_name), FormatTiming(hit));
+        }
+
+        auto stats = crow::shader_cache.GetStats();
+        std::cout << std::format("Cache: {} hits, {} misses", stats.hits,
+                                 stats.misses)
+                  << "\n";
+
+        crow::shader_cache.Clear();
+        crow::shader_cache.Close();
+
+        std::error_code ec;
+        std::filesystem::remove_all(cache_directory, ec);
+    }
+
+    std::string batch_results;
+
+    for (auto optimization : optimizations) {
+        std::vector<crow::ShaderCompileJob> jobs;
+        for (auto& shader : shaders) {
+            crow::ShaderCompileSettings settings{};
+            settings.optimization = optimization;
+
+            jobs.push_back({shader.file_name, shader.code, shader.stage, {},
+                            shader.include_path, settings});
+        }
+
+        // The pool starts its threads on first use, which a long running
+        // editor has long since paid for
+        crow::thread_pool.Submit([]() {}).wait();
+
+        auto start = Clock::now();
+
+        for (auto& future : crow::shader_compiler.CompileBatch(jobs)) {
+            future.wait();
+        }
+
+        auto total_ms = ToMilliseconds(Clock::now() - start);
+
+        if (!batch_results.empty()) {
+            batch_results += ",\n";
+        }
+
+        batch_results += std::format(
+            "    {{\"optimization\": \"{}\", \"jobs\": {}, \"threads\": {}, "
+            "\"total_ms\": {:.4f}, \"shaders_per_second\": {:.2f}}}",
+            GetOptimizationName(optimization), jobs.size(),
+            crow::thread_pool.GetThreadCount(), total_ms,
+            double(jobs.size()) / (total_ms / 1000.0));
+
+        std::cout << std::format("Batch {}: {} shaders in {:.2f} ms",
+                                 GetOptimizationName(optimization),
+                                 jobs.size(), total_ms)
+                  << "\n";
+    }
+
+    std::ofstream output(output_path, std::ios::trunc);
+    if (!output) {
+        std::cerr << "Could not write " << output_path.string() << "\n";
+        return -1;
+    }
+
+    output << "{\n"
+           << "  \"iterations\": " << iterations << ",\n"
+           << "  \"compile\": [\n"
+           << results << "\n  ],\n"
+           << "  \"cache\": [\n"
+           << cache_results << "\n  ],\n"
+           << "  \"batch\": [\n"
+           << batch_results << "\n  ]\n"
+           << "}\n";
+
+    std::cout << "Wrote " << output_path.string() << "\n";
+}
\ No newline at end of file
@@ -0,0 +1,180 @@
+#include <Crow/Shader.hpp>
+#include <Crow/ShaderArchive.hpp>
+#include <Crow/ShaderInclude.hpp>
+#include <Crow/ShaderPermutation.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+void PrintUsage() {
+    std::cerr << "Usage: crowshaderc [options] <shader directory> <archive>\n"
+                 "  -I <directory>  Add an include directory\n"
+                 "  -m <manifest>   Also compile the variants in a manifest\n"
+                 "  -g              Generate debug info\n"
+                 "  -O0             No optimization\n"
+                 "  -Os             Optimize for size\n"
+                 "  -O              Optimize for performance (default)\n";
+}
+
+std::optional<std::string> ReadFile(const std::filesystem::path& path) {
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream) {
+        std::cerr << "Could not read " << path.string() << "\n";
+        return {};
+    }
+
+    return std::string{std::istreambuf_iterator<char>(stream),
+                       std::istreambuf_iterator<char>()};
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    crow::ShaderCompileSettings settings{};
+    std::vector<std::string> paths;
+    std::optional<std::filesystem::path> manifest_path;
+
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+
+        if (arg == "-I" && i + 1 < argc) {
+            crow::shader_includer.AddIncludeDirectory(argv[++i]);
+        } else if (arg == "-m" && i + 1 < argc) {
+            manifest_path = argv[++i];
+        } else if (arg == "-g") {
+            settings.gen_debug = true;
+        } else if (arg == "-O0") {
+            settings.optimization = crow::ShaderOptimization::Zero;
+        } else if (arg == "-Os") {
+            settings.optimization = crow::ShaderOptimization::Size;
+        } else if (arg == "-O") {
+            settings.optimization = crow::ShaderOptimization::Performance;
+        } else if (arg.starts_with("-")) {
+            PrintUsage();
+            return -1;
+        } else {
+            paths.emplace_back(arg);
+        }
+    }
+
+    if (paths.size() != 2) {
+        PrintUsage();
+        return -1;
+    }
+
+    std::filesystem::path shader_directory = paths[0];
+    std::filesystem::path archive_path = paths[1];
+
+    std::vector<crow::ShaderCompileJob> jobs;
+    std::vector<std::string> names;
+
+    std::error_code ec;
+    for (auto& file :
+         std::filesystem::recursive_directory_iterator(shader_directory, ec)) {
+        if (!file.is_regular_file()) {
+            continue;
+        }
+
+        auto stage = crow::GetShaderStageFromPath(file.path());
+        if (!stage) {
+            continue;
+        }
+
+        auto code = ReadFile(file.path());
+        if (!code) {
+            return -1;
+        }
+
+        crow::ShaderCompileJob job{};
+        job.file_name = file.path().generic_string();
+        job.code = std::move(code.value());
+        job.stage = stage.value();
+        job.include_path = shader_directory.generic_string();
+        job.settings = settings;
+
+        jobs.push_back(std::move(job));
+
+        // Shaders are looked up by their path inside the shader directory
+        names.push_back(
+            file.path().lexically_relative(shader_directory).generic_string());
+    }
+
+    if (ec) {
+        std::cerr << "Could not read shader directory "
+                  << shader_directory.string() << ": " << ec.message()
+                  << "\n";
+        return -1;
+    }
+
+    if (manifest_path) {
+        auto records = crow::ShaderVariantManifest::Read(manifest_path.value());
+        if (!records) {
+            std::cerr << "Could not read manifest " << manifest_path->string()
+                      << "\n";
+            return -1;
+        }
+
+        for (auto& record : records.value()) {
+            // Recorded names are usually relative to the shader directory
+            auto source = shader_directory / record.file_name;
+            if (!std::filesystem::exists(source)) {
+                source = record.file_name;
+            }
+
+            auto code = ReadFile(source);
+            if (!code) {
+                return -1;
+            }
+
+            crow::ShaderCompileJob job{};
+            job.file_name = source.generic_string();
+            job.code = std::move(code.value());
+            job.stage = record.stage;
+            job.defines = record.defines;
+            job.include_path = shader_directory.generic_string();
+            job.settings = settings;
+
+            jobs.push_back(std::move(job));
+
+            // Looked up at runtime by the name the permutation recorded
+            names.push_back(crow::GetShaderVariantName(record.file_name,
+                                                       record.defines));
+        }
+    }
+
+    auto futures = crow::shader_compiler.CompileBatch(jobs);
+
+    crow::ShaderArchiveWriter writer;
+    bool failed = false;
+
+    for (size_t i = 0; i < futures.size(); i++) {
+        auto spir_v = futures[i].get();
+        if (spir_v.empty()) {
+            std::cerr << "Could not compile " << jobs[i].file_name << "\n";
+            failed = true;
+            continue;
+        }
+
+        writer.Add(names[i], std::move(spir_v));
+    }
+
+    if (failed) {
+        return -1;
+    }
+
+    if (!writer.Write(archive_path)) {
+        std::cerr << "Could not write " << archive_path.string() << "\n";
+        return -1;
+    }
+
+    std::cout << "Wrote " << jobs.size() << " shaders to "
+              << archive_path.string() << "\n";
+}
\ No newline at end of file
@@ -0,0 +1,112 @@
+#ifndef CROW_ALLOCATOR_HPP
+#define CROW_ALLOCATOR_HPP
+
+#include <Crow/Vulkan.hpp>
+
+#include <vk_mem_alloc.h>
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace crow {
+
+enum class MemoryUsage {
+    // Only the GPU touches it, filled by copies
+    Device,
+    // Written by the CPU every frame and read by the GPU, device local when
+    // the device has memory the CPU can write to
+    Upload,
+    // Copied from once and then released, kept within budget
+    Staging,
+    // Written by the GPU and read back by the CPU
+    Readback
+};
+
+struct Buffer {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VmaAllocation allocation = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+    // Persistently mapped, null for device memory
+    void* data = nullptr;
+};
+
+struct Image {
+    VkImage image = VK_NULL_HANDLE;
+    VmaAllocation allocation = VK_NULL_HANDLE;
+};
+
+struct HeapStats {
+    bool device_local;
+    // Bytes used by this process and how many it should stay under. Without
+    // VK_EXT_memory_budget these are estimates
+    VkDeviceSize usage;
+    VkDeviceSize budget;
+    // Bytes in VkDeviceMemory blocks, and of those the bytes in allocations
+    VkDeviceSize block_bytes;
+    VkDeviceSize allocation_bytes;
+    uint32_t blocks;
+    uint32_t allocations;
+};
+
+// The one place buffers and images get their memory from, on top of the
+// VmaAllocator. Staging and readback buffers come from pools of their own so
+// that short lived allocations do not fragment the default blocks, and large
+// render targets get dedicated allocations
+class MemoryAllocator {
+  private:
+    VmaAllocator allocator = VK_NULL_HANDLE;
+
+    VmaPool staging_pool = VK_NULL_HANDLE;
+    VmaPool readback_pool = VK_NULL_HANDLE;
+
+    bool over_budget = false;
+
+    bool CreatePool(VkBufferUsageFlags usage, VmaAllocationCreateFlags flags,
+                    VmaPool& pool);
+
+  public:
+    MemoryAllocator() = default;
+
+    MemoryAllocator(const MemoryAllocator&) = delete;
+    MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+    // Called once the device exists
+    bool Create();
+    void Destroy();
+
+    inline VmaAllocator Get() const { return allocator; }
+
+    // Refreshes the budgets, called once per frame
+    void NewFrame();
+
+    std::optional<Buffer> CreateBuffer(VkDeviceSize size,
+                                       VkBufferUsageFlags usage,
+                                       MemoryUsage memory_usage);
+    // Always device memory
+    std::optional<Image> CreateImage(const VkImageCreateInfo& image_info);
+
+    // Memory to bind resources to by hand, such as aliased images. The
+    // requirements memory type bits pick the memory type
+    std::optional<VmaAllocation>
+    AllocateMemory(const VkMemoryRequirements& requirements, bool dedicated);
+
+    // Destroys right away, the GPU must be done with it
+    void DestroyBuffer(const Buffer& buffer);
+    void DestroyImage(const Image& image);
+    void FreeMemory(VmaAllocation allocation);
+
+    // Destroys through the deletion queue once the GPU is done with it
+    void ReleaseBuffer(const Buffer& buffer);
+    void ReleaseImage(const Image& image);
+    void ReleaseMemory(VmaAllocation allocation);
+
+    std::vector<HeapStats> GetHeapStats() const;
+    inline bool IsOverBudget() const { return over_budget; }
+};
+
+inline MemoryAllocator memory_allocator;
+
+} // namespace crow
+
+#endif
\ No newline at end of file
@@ -0,0 +1,69 @@
+#ifndef CROW_COMMAND_RECORDER_HPP
+#define CROW_COMMAND_RECORDER_HPP
+
+#include <Crow/Vulkan.hpp>
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace crow {
+
+// Records the items in [begin, end) into a secondary command buffer
+using RecordFunction =
+    std::function<void(VkCommandBuffer cmd, size_t begin, size_t end)>;
+
+// Records secondary command buffers on the thread pool. Every thread gets a
+// command pool per frame in flight, so recording never shares a pool between
+// threads, and each pool is reset once per frame with vkResetCommandPool
+class CommandRecorder {
+  private:
+    struct FramePool {
+        VkCommandPool pool = VK_NULL_HANDLE;
+        // Kept across resets and handed out again
+        std::vector<VkCommandBuffer> buffers;
+        size_t used = 0;
+    };
+
+    struct ThreadPools {
+        std::vector<FramePool> frames;
+    };
+
+    std::unordered_map<std::thread::id, std::unique_ptr<ThreadPools>> threads;
+    std::mutex mutex;
+
+    std::optional<VkCommandBuffer> AllocateSecondary();
+
+  public:
+    CommandRecorder() = default;
+
+    CommandRecorder(const CommandRecorder&) = delete;
+    CommandRecorder& operator=(const CommandRecorder&) = delete;
+
+    // Resets the pools of the current frame in flight, which must be done
+    // executing
+    void ResetFrame();
+
+    // Splits count items into chunks of at least min_chunk_size and records
+    // them in parallel. The main thread and the pool threads claim chunks as
+    // they free up, so a pool busy with compiles only slows recording. The
+    // secondaries are executed into primary in chunk order, so the result
+    // does not depend on which thread finished first
+    bool Record(VkCommandBuffer primary,
+                const VkCommandBufferInheritanceInfo& inheritance,
+                size_t count, const RecordFunction& record,
+                size_t min_chunk_size = 256);
+
+    void Destroy();
+};
+
+inline CommandRecorder command_recorder;
+
+} // namespace crow
+
+#endif
\ No newline at end of file
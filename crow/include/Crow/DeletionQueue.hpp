@@ -0,0 +1,69 @@
+#ifndef CROW_DELETION_QUEUE_HPP
+#define CROW_DELETION_QUEUE_HPP
+
+#include <Crow/Vulkan.hpp>
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+namespace crow {
+
+// Destroys objects once the GPU can no longer be using them. Everything
+// pushed is stamped with the next timeline values of the graphics and compute
+// queues, or the current frame without timelines, and destroyed once the GPU
+// has passed that point. Releasing an object at runtime never waits for the
+// device
+class DeletionQueue {
+  private:
+    struct Deletion {
+        uint64_t frame;
+        uint64_t graphics_value;
+        uint64_t compute_value;
+        std::function<void()> destroy;
+    };
+
+    static bool IsFinished(const Deletion& deletion);
+
+    // Stamps only ever grow, so the oldest deletion is always at the front
+    std::deque<Deletion> deletions;
+    std::mutex mutex;
+
+  public:
+    DeletionQueue() = default;
+
+    DeletionQueue(const DeletionQueue&) = delete;
+    DeletionQueue& operator=(const DeletionQueue&) = delete;
+
+    void Push(std::function<void()> destroy);
+
+    void Push(VkBuffer buffer);
+    void Push(VkImage image);
+    void Push(VkImageView image_view);
+    void Push(VkSampler sampler);
+    void Push(VkFramebuffer framebuffer);
+    void Push(VkRenderPass render_pass);
+    void Push(VkPipeline pipeline);
+    void Push(VkShaderModule module);
+    void Push(VkDescriptorPool descriptor_pool);
+    void Push(VkSemaphore semaphore);
+
+    // Called at the start of a frame, after waiting for the frame in flight
+    // and before recording anything
+    void Flush();
+
+    inline size_t GetPendingCount() {
+        std::lock_guard lock{mutex};
+        return deletions.size();
+    }
+
+    // Destroys everything, the device must be idle
+    void Destroy();
+};
+
+inline DeletionQueue deletion_queue;
+
+} // namespace crow
+
+#endif
\ No newline at end of file
@@ -0,0 +1,51 @@
+#ifndef CROW_HASH_HPP
+#define CROW_HASH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <type_traits>
+
+namespace crow {
+
+constexpr uint64_t hash_seed = 0xcbf29ce484222325ull;
+
+// FNV-1a, stable across runs so it can be used for on-disk keys
+inline uint64_t HashBytes(const void* data, size_t size,
+                          uint64_t hash = hash_seed) {
+    auto bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+inline uint64_t HashString(std::string_view str, uint64_t hash = hash_seed) {
+    hash = HashBytes(str.data(), str.size(), hash);
+    // Terminate so that ("ab", "c") and ("a", "bc") do not collide
+    return HashBytes("\0", 1, hash);
+}
+
+template <typename T>
+    requires std::is_trivially_copyable_v<T>
+inline uint64_t HashValue(const T& value, uint64_t hash = hash_seed) {
+    return HashBytes(&value, sizeof(T), hash);
+}
+
+template <typename T>
+    requires std::is_trivially_copyable_v<T>
+inline uint64_t HashSpan(std::span<const T> values,
+                         uint64_t hash = hash_seed) {
+    hash = HashValue(values.size(), hash);
+    return HashBytes(values.data(), values.size_bytes(), hash);
+}
+
+inline uint64_t HashCombine(uint64_t hash, uint64_t value) {
+    return HashValue(value, hash);
+}
+
+} // namespace crow
+
+#endif
\ No newline at end of file
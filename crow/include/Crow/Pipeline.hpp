@@ -0,0 +1,292 @@
+#ifndef CROW_PIPELINE_HPP
+#define CROW_PIPELINE_HPP
+
+#include <Crow/Shader.hpp>
+#include <Crow/Vulkan.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace crow {
+
+// The four pieces of a graphics pipeline that VK_EXT_graphics_pipeline_library
+// can compile separately
+enum class PipelineLibraryPart {
+    VertexInput,
+    PreRasterization,
+    FragmentShader,
+    FragmentOutput
+};
+
+// Everything that goes into a graphics pipeline. Viewport and scissor are
+// always dynamic. The render pass is only used to create the pipeline, the
+// attachment formats and sample count stand in for it when hashing so that
+// compatible render passes share pipelines. Without a render pass the
+// pipeline is made for dynamic rendering with the same formats
+struct GraphicsPipelineState {
+    std::vector<ShaderStage> stages;
+
+    std::vector<VkVertexInputBindingDescription> vertex_bindings;
+    std::vector<VkVertexInputAttributeDescription> vertex_attributes;
+
+    VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    VkPolygonMode polygon_mode = VK_POLYGON_MODE_FILL;
+    VkCullModeFlags cull_mode = VK_CULL_MODE_NONE;
+    VkFrontFace front_face = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+    bool depth_test = false;
+    bool depth_write = false;
+    // Reverse Z, the renderer clears depth to 0
+    VkCompareOp depth_compare = VK_COMPARE_OP_GREATER_OR_EQUAL;
+
+    std::vector<VkPipelineColorBlendAttachmentState> blend_attachments;
+
+    std::vector<VkFormat> color_formats;
+    VkFormat depth_format = VK_FORMAT_UNDEFINED;
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    VkRenderPass render_pass = VK_NULL_HANDLE;
+    uint32_t subpass = 0;
+
+    // Bytes that identify the pipeline, used for hashing and comparing
+    std::vector<std::byte> GetKey() const;
+    // Same as above, but only the state that goes into one library part
+    std::vector<std::byte> GetPartKey(PipelineLibraryPart part) const;
+};
+
+class GraphicsPipelineBuilder {
+  private:
+    GraphicsPipelineState state;
+
+  public:
+    inline GraphicsPipelineBuilder& AddStage(ShaderStage stage) {
+        state.stages.push_back(std::move(stage));
+        return *this;
+    }
+
+    inline GraphicsPipelineBuilder&
+    AddVertexBinding(uint32_t binding, uint32_t stride,
+                     VkVertexInputRate rate = VK_VERTEX_INPUT_RATE_VERTEX) {
+        state.vertex_bindings.push_back({binding, stride, rate});
+        return *this;
+    }
+
+    inline GraphicsPipelineBuilder&
+    AddVertexAttribute(uint32_t location, uint32_t binding, VkFormat format,
+                       uint32_t offset) {
+        state.vertex_attributes.push_back({location, binding, format, offset});
+        return *this;
+    }
+
+    inline GraphicsPipelineBuilder& SetTopology(VkPrimitiveTopology topology) {
+        state.topology = topology;
+        return *this;
+    }
+
+    inline GraphicsPipelineBuilder& SetPolygonMode(VkPolygonMode mode) {
+        state.polygon_mode = mode;
+        return *this;
+    }
+
+    inline GraphicsPipelineBuilder& SetCullMode(VkCullModeFlags cull_mode,
+                                                VkFrontFace front_face) {
+        state.cull_mode = cull_mode;
+        state.front_face = front_face;
+        return *this;
+    }
+
+    inline GraphicsPipelineBuilder&
+    SetDepth(bool test, bool write,
+             VkCompareOp compare = VK_COMPARE_OP_GREATER_OR_EQUAL) {
+        state.depth_test = test;
+        state.depth_write = write;
+        state.depth_compare = compare;
+        return *this;
+    }
+
+    // Adds a color attachment without blending
+    GraphicsPipelineBuilder& AddColorAttachment(VkFormat format);
+    GraphicsPipelineBuilder& AddBlendedColorAttachment(VkFormat format);
+
+    inline GraphicsPipelineBuilder& SetDepthFormat(VkFormat format) {
+        state.depth_format = format;
+        return *this;
+    }
+
+    inline GraphicsPipelineBuilder& SetSamples(VkSampleCountFlagBits samples) {
+        state.samples = samples;
+        return *this;
+    }
+
+    inline GraphicsPipelineBuilder& SetLayout(VkPipelineLayout layout) {
+        state.layout = layout;
+        return *this;
+    }
+
+    inline GraphicsPipelineBuilder& SetRenderPass(VkRenderPass render_pass,
+                                                  uint32_t subpass = 0) {
+        state.render_pass = render_pass;
+        state.subpass = subpass;
+        return *this;
+    }
+
+    inline const GraphicsPipelineState& Build() const { return state; }
+};
+
+struct PipelineLibraryStats {
+    uint64_t parts;
+    uint64_t fast_links;
+    uint64_t optimized_links;
+    // Nanoseconds spent creating parts and in each kind of link
+    uint64_t part_time;
+    uint64_t fast_link_time;
+    uint64_t optimized_link_time;
+    // Sampled full creations of linked pipelines, the baseline for the
+    // time saved
+    uint64_t full_creations;
+    uint64_t full_creation_time;
+};
+
+// Caches the parts of graphics pipelines built with
+// VK_EXT_graphics_pipeline_library. Pipelines that share a vertex format,
+// vertex shader or output formats share those parts, so most new pipelines
+// only need a link
+class PipelineLibraryCache {
+  private:
+    struct Part {
+        std::vector<std::byte> key;
+        VkPipeline pipeline;
+    };
+
+    std::unordered_multimap<uint64_t, Part> parts;
+    std::mutex mutex;
+
+    std::atomic<uint64_t> fast_links = 0;
+    std::atomic<uint64_t> optimized_links = 0;
+    std::atomic<uint64_t> part_time = 0;
+    std::atomic<uint64_t> fast_link_time = 0;
+    std::atomic<uint64_t> optimized_link_time = 0;
+    std::atomic<uint64_t> full_creations = 0;
+    std::atomic<uint64_t> full_creation_time = 0;
+    std::atomic<uint64_t> samples = 0;
+
+    std::optional<VkPipeline> FindPart(PipelineLibraryPart part,
+                                       const GraphicsPipelineState& state);
+    std::optional<VkPipeline> GetPart(PipelineLibraryPart part,
+                                      GraphicsPipelineState& state,
+                                      VkPipelineCache cache);
+
+  public:
+    PipelineLibraryCache() = default;
+
+    PipelineLibraryCache(const PipelineLibraryCache&) = delete;
+    PipelineLibraryCache& operator=(const PipelineLibraryCache&) = delete;
+
+    // True when a link would not have to compile any part
+    bool HasParts(const GraphicsPipelineState& state);
+
+    // Creates the missing parts and links them. Without optimize the link is
+    // fast but the pipeline may run slower
+    std::optional<VkPipeline> Link(GraphicsPipelineState& state, bool optimize,
+                                   VkPipelineCache cache);
+
+    // Debug builds also create every few linked pipelines the usual way, so
+    // that Destroy can report how much time linking saved
+    void SampleFullCreation(GraphicsPipelineState& state);
+
+    PipelineLibraryStats GetStats();
+
+    void Destroy();
+};
+
+inline PipelineLibraryCache pipeline_library_cache;
+
+// What GetPipeline does when the pipeline is still compiling
+enum class PipelineMissBehavior { Skip, Fallback, Wait };
+
+struct PipelineManagerStats {
+    uint64_t pipelines;
+    uint64_t pending;
+    uint64_t failed;
+};
+
+// Owns every graphics pipeline. Pipelines are created on the thread pool the
+// first time they are asked for, so a new material costs a few frames of
+// fallback instead of a hitch. With graphics pipeline libraries the first
+// pipeline is a quick link of cached parts, replaced by an optimized link
+// once that finishes. Shader modules must stay alive until the pipelines
+// using them are ready, and pipelines are dropped once their SPIR-V is
+// invalidated
+class PipelineManager {
+  private:
+    enum class Status { Pending, Ready, Failed };
+
+    struct Entry {
+        std::vector<std::byte> key;
+        GraphicsPipelineState state;
+        std::atomic<Status> status = Status::Pending;
+        std::atomic<VkPipeline> pipeline = VK_NULL_HANDLE;
+        // The quick link is kept until Destroy since frames in flight may
+        // still use it after the optimized pipeline replaced it
+        VkPipeline fast_pipeline = VK_NULL_HANDLE;
+        std::shared_future<void> compiled;
+    };
+
+    // Keyed by hash, the full key is compared on lookup in case of collisions
+    std::unordered_multimap<uint64_t, std::shared_ptr<Entry>> pipelines;
+    // Invalidated entries, destroyed once their compile has finished
+    std::vector<std::shared_ptr<Entry>> retired;
+    std::mutex mutex;
+
+    VkPipeline fallback = VK_NULL_HANDLE;
+
+    std::shared_ptr<Entry> FindOrQueue(const GraphicsPipelineState& state);
+    static void Compile(Entry& entry);
+    static void DestroyEntry(Entry& entry);
+
+  public:
+    PipelineManager() = default;
+
+    PipelineManager(const PipelineManager&) = delete;
+    PipelineManager& operator=(const PipelineManager&) = delete;
+
+    // Nothing is returned when the pipeline failed, or when it is not ready
+    // and the behavior is Skip, or Fallback without a fallback set
+    std::optional<VkPipeline>
+    GetPipeline(const GraphicsPipelineState& state,
+                PipelineMissBehavior behavior = PipelineMissBehavior::Skip);
+
+    // Starts compiling ahead of time, for example while loading a level
+    void Prepare(const GraphicsPipelineState& state);
+
+    // The fallback is created right away, it should be cheap and compatible
+    // with the render passes it stands in for
+    bool SetFallback(const GraphicsPipelineState& state);
+
+    // Drops every pipeline built from the SPIR-V with this hash, the next
+    // GetPipeline with the same state compiles it again
+    void Invalidate(uint64_t shader_hash);
+
+    PipelineManagerStats GetStats();
+
+    // Waits for pending compiles and destroys every pipeline
+    void Destroy();
+};
+
+inline PipelineManager pipeline_manager;
+
+std::optional<VkPipeline>
+CreateGraphicsPipeline(GraphicsPipelineState& state,
+                       VkPipelineCache cache = VK_NULL_HANDLE);
+
+} // namespace crow
+
+#endif
\ No newline at end of file
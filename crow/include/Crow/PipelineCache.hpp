@@ -0,0 +1,68 @@
+#ifndef CROW_PIPELINE_CACHE_HPP
+#define CROW_PIPELINE_CACHE_HPP
+
+#include <Crow/Vulkan.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <vector>
+
+namespace crow {
+
+// Engine owned VkPipelineCache that survives between runs. The file is only
+// handed to the driver when it was written by the same vendor, device and
+// driver build, anything else starts with an empty cache
+class PipelineCache {
+  private:
+    VkPipelineCache cache = VK_NULL_HANDLE;
+    std::filesystem::path path;
+
+    // Caches handed to worker threads, merged back on MergeWorkerCaches
+    std::vector<VkPipelineCache> worker_caches;
+    std::mutex mutex;
+
+    // Time spent creating pipelines this session, and the time and count of
+    // the last session that started without a usable cache. Sessions create
+    // different numbers of pipelines, so they are compared per pipeline
+    std::atomic<uint64_t> creation_time = 0;
+    std::atomic<uint64_t> creation_count = 0;
+    uint64_t cold_creation_time = 0;
+    uint64_t cold_creation_count = 0;
+    bool warm = false;
+
+  public:
+    PipelineCache() = default;
+
+    PipelineCache(const PipelineCache&) = delete;
+    PipelineCache& operator=(const PipelineCache&) = delete;
+
+    // Must be called after the device is created
+    bool Load(const std::filesystem::path& path);
+    bool Save();
+    void Destroy();
+
+    inline VkPipelineCache Get() const { return cache; }
+    inline bool IsWarm() const { return warm; }
+
+    // Worker threads get their own cache so they do not contend on the main
+    // one. Released caches are merged into the main cache later
+    VkPipelineCache AcquireWorkerCache();
+    void ReleaseWorkerCache(VkPipelineCache worker_cache);
+    void MergeWorkerCaches();
+
+    // Pipeline creation reports how long the driver took so that the time
+    // saved by the cache can be logged
+    inline void AddCreationTime(std::chrono::nanoseconds time) {
+        creation_time += uint64_t(time.count());
+        creation_count++;
+    }
+};
+
+inline PipelineCache pipeline_cache;
+
+} // namespace crow
+
+#endif
\ No newline at end of file
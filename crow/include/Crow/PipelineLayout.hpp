@@ -0,0 +1,71 @@
+#ifndef CROW_PIPELINE_LAYOUT_HPP
+#define CROW_PIPELINE_LAYOUT_HPP
+
+#include <Crow/ShaderReflection.hpp>
+#include <Crow/Vulkan.hpp>
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace crow {
+
+struct PipelineLayoutInfo {
+    VkPipelineLayout layout;
+    std::vector<VkDescriptorSetLayout> set_layouts;
+};
+
+// Creates descriptor set and pipeline layouts once per unique description and
+// hands out the shared handles afterwards. Everything lives until Destroy
+class PipelineLayoutCache {
+  private:
+    struct SetLayoutEntry {
+        std::vector<VkDescriptorSetLayoutBinding> bindings;
+        VkDescriptorSetLayout layout;
+    };
+
+    struct PipelineLayoutEntry {
+        std::vector<VkDescriptorSetLayout> set_layouts;
+        std::vector<VkPushConstantRange> push_constant_ranges;
+        VkPipelineLayoutCreateFlags flags;
+        VkPipelineLayout layout;
+    };
+
+    // Keyed by hash, the full description is compared on lookup in case of
+    // collisions
+    std::unordered_multimap<uint64_t, SetLayoutEntry> set_layouts;
+    std::unordered_multimap<uint64_t, PipelineLayoutEntry> pipeline_layouts;
+
+    std::mutex mutex;
+
+  public:
+    std::optional<VkDescriptorSetLayout>
+    GetDescriptorSetLayout(std::vector<VkDescriptorSetLayoutBinding> bindings);
+
+    std::optional<VkPipelineLayout>
+    GetPipelineLayout(std::span<const VkDescriptorSetLayout> set_layouts,
+                      std::span<const VkPushConstantRange> push_constant_ranges,
+                      VkPipelineLayoutCreateFlags flags = 0);
+
+    std::optional<PipelineLayoutInfo>
+    GetPipelineLayout(const PipelineLayoutDescription& description,
+                      VkPipelineLayoutCreateFlags flags = 0);
+
+    std::optional<PipelineLayoutInfo>
+    GetPipelineLayout(std::span<const ShaderReflection> stages,
+                      VkPipelineLayoutCreateFlags flags = 0);
+
+    size_t GetDescriptorSetLayoutCount();
+    size_t GetPipelineLayoutCount();
+
+    void Destroy();
+};
+
+inline PipelineLayoutCache pipeline_layout_cache;
+
+} // namespace crow
+
+#endif
\ No newline at end of file
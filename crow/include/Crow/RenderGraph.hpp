@@ -0,0 +1,217 @@
+#ifndef CROW_RENDER_GRAPH_HPP
+#define CROW_RENDER_GRAPH_HPP
+
+#include <Crow/Allocator.hpp>
+#include <Crow/Vulkan.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace crow {
+
+// How a pass uses an image, decides the stages, access and layout the graph
+// synchronizes with
+enum class RenderGraphAccess {
+    ColorAttachment,
+    DepthAttachment,
+    DepthRead,
+    Sampled,
+    StorageRead,
+    StorageWrite,
+    TransferSrc,
+    TransferDst
+};
+
+// Only valid until the graph is executed
+using RenderGraphImage = uint32_t;
+
+struct RenderGraphImageDesc {
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    // Zero follows the swapchain extent
+    uint32_t width = 0;
+    uint32_t height = 0;
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+};
+
+class RenderGraph;
+
+class RenderGraphPassBuilder {
+  private:
+    RenderGraph& graph;
+    size_t pass;
+
+  public:
+    RenderGraphPassBuilder(RenderGraph& graph, size_t pass)
+        : graph{graph}, pass{pass} {}
+
+    RenderGraphPassBuilder& Read(RenderGraphImage image,
+                                 RenderGraphAccess access);
+    RenderGraphPassBuilder& Write(RenderGraphImage image,
+                                  RenderGraphAccess access);
+
+    // The pass is never culled, for effects the graph cannot see
+    RenderGraphPassBuilder& SetSideEffects();
+
+    // The pass has to be the last one. It is still open when Execute
+    // returns so that more commands can be recorded into it, and the images
+    // it uses are left in the layout it needs. The renderer uses this for
+    // the swapchain pass
+    RenderGraphPassBuilder& SetOpen();
+};
+
+using RenderGraphSetup = std::function<void(RenderGraphPassBuilder& builder)>;
+using RenderGraphExecute =
+    std::function<void(VkCommandBuffer cmd, const RenderGraph& graph)>;
+
+struct RenderGraphStats {
+    uint64_t passes;
+    uint64_t culled_passes;
+    uint64_t barriers;
+    uint64_t transient_images;
+    // Bytes of transient memory with and without aliasing
+    uint64_t transient_memory;
+    uint64_t unaliased_memory;
+};
+
+// Passes declare the images they read and write, and the graph works out
+// the rest when it is executed. Passes nothing depends on are culled, the
+// barriers and layout transitions between passes are batched per pass, and
+// transient images whose lifetimes do not overlap share memory. The graph is
+// built again every frame, the transient images are kept for as long as the
+// graph keeps the same shape
+class RenderGraph {
+  private:
+    struct Use {
+        RenderGraphImage image;
+        RenderGraphAccess access;
+        bool write;
+    };
+
+    struct Pass {
+        std::string name;
+        std::vector<Use> uses;
+        RenderGraphExecute execute;
+        bool side_effects = false;
+        bool open = false;
+        bool culled = false;
+        std::vector<VkImageMemoryBarrier2> barriers;
+    };
+
+    struct Image {
+        std::string name;
+        RenderGraphImageDesc desc;
+        VkImageUsageFlags usage = 0;
+
+        bool imported = false;
+        VkImageLayout initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkImageLayout final_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+
+        // Executed pass indices
+        size_t first_use = SIZE_MAX;
+        size_t last_use = 0;
+        size_t first_write = SIZE_MAX;
+    };
+
+    struct Block {
+        uint32_t memory_type;
+        VkDeviceSize size;
+        VmaAllocation allocation;
+    };
+
+    // Transient images and their memory, rebuilt when the key changes
+    struct Physical {
+        std::vector<uint64_t> key;
+        std::vector<VkImage> images;
+        std::vector<VkImageView> views;
+        std::vector<Block> blocks;
+        // Stages and access of everything sharing memory with each image,
+        // its first use has to wait for those
+        std::vector<VkPipelineStageFlags2> alias_stages;
+        std::vector<VkAccessFlags2> alias_access;
+        uint64_t aliased_size = 0;
+        uint64_t unaliased_size = 0;
+    };
+
+    std::vector<Pass> passes;
+    std::vector<Image> images;
+    std::vector<VkImageMemoryBarrier2> final_barriers;
+
+    std::optional<RenderGraphImage> swapchain_image;
+    // Executed index of the pass being recorded
+    size_t executing = 0;
+
+    Physical physical;
+    RenderGraphStats stats{};
+
+    friend class RenderGraphPassBuilder;
+
+    void Cull();
+    void ComputeLifetimes();
+    bool Allocate();
+    void BuildBarriers();
+    void RetirePhysical();
+
+    static void
+    EmitBarriers(VkCommandBuffer cmd,
+                 const std::vector<VkImageMemoryBarrier2>& barriers);
+
+  public:
+    RenderGraph() = default;
+
+    RenderGraph(const RenderGraph&) = delete;
+    RenderGraph& operator=(const RenderGraph&) = delete;
+
+    RenderGraphImage CreateImage(std::string name,
+                                 const RenderGraphImageDesc& desc);
+
+    // The image is left in final_layout after the graph
+    RenderGraphImage ImportImage(std::string name, VkImage image,
+                                 VkImageView view, VkFormat format,
+                                 VkExtent2D extent, VkImageLayout layout,
+                                 VkImageLayout final_layout);
+
+    // The image that is presented this frame. Passes can use it before the
+    // frame has started, the renderer binds the acquired image in StartFrame
+    RenderGraphImage GetSwapchainImage();
+    void BindSwapchainImage(VkImage image, VkImageView view);
+
+    void AddPass(std::string name, const RenderGraphSetup& setup,
+                 RenderGraphExecute execute);
+
+    inline bool IsEmpty() const { return passes.empty(); }
+
+    // Compiles and records the graph into cmd, then clears it for the next
+    // frame
+    bool Execute(VkCommandBuffer cmd);
+
+    // Drops the passes and images without executing them
+    void Reset();
+
+    VkImage GetImage(RenderGraphImage image) const;
+    VkImageView GetImageView(RenderGraphImage image) const;
+    VkFormat GetFormat(RenderGraphImage image) const;
+    VkExtent2D GetExtent(RenderGraphImage image) const;
+
+    // While executing, true when an earlier pass wrote the image
+    inline bool HasContents(RenderGraphImage image) const {
+        return images[image].first_write < executing;
+    }
+
+    // From the last executed graph
+    inline const RenderGraphStats& GetStats() const { return stats; }
+
+    void Destroy();
+};
+
+inline RenderGraph render_graph;
+
+} // namespace crow
+
+#endif
\ No newline at end of file
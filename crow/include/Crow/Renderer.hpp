@@ -1,22 +1,84 @@
 #ifndef CROW_RENDERER_HPP
 #define CROW_RENDERER_HPP
 
+#include <Crow/CommandRecorder.hpp>
 #include <Crow/Vulkan.hpp>
 #include <cstddef>
 #include <memory>
+#include <vector>
 
 namespace crow {
 
 class Renderer {
+    enum class ComputeState { Empty, Recording, Submitted };
+
+    // Timeline values each frame in flight signals when it is done
+    struct FrameValues {
+        uint64_t graphics = 0;
+        uint64_t compute = 0;
+    };
+
     uint32_t current_framebuffer;
 
+    std::vector<FrameValues> frame_values;
+
+    ComputeState compute_state = ComputeState::Empty;
+    VkPipelineStageFlags compute_wait_stages = 0;
+    uint64_t compute_value = 0;
+
+    VkSubpassContents render_pass_contents = VK_SUBPASS_CONTENTS_INLINE;
+
+    void WaitForFrame();
+
+    // The last pass of the render graph, left open for the draws of the
+    // frame. Without load the image is cleared
+    void BeginSwapchainPass(VkCommandBuffer cmd, bool load);
+
+    // Used instead of the render pass with dynamic rendering
+    void BeginRendering(VkCommandBuffer cmd, bool load);
+    void EndRendering();
+
+    void SubmitGraphicsWithTimelines();
+    void SubmitGraphicsWithFences();
+
   public:
-    void StartFrame();
+    // False when there is no image to draw to, the frame should be skipped.
+    // Frames recorded with RecordParallel pass
+    // VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS. Executes the passes added
+    // to the render graph since the last frame, the swapchain pass runs last
+    // and stays open until SubmitFrame
+    bool StartFrame(VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
     void SubmitFrame();
 
+    // Records count items into the main render pass across the thread pool,
+    // see CommandRecorder::Record
+    bool RecordParallel(size_t count, const RecordFunction& record,
+                        size_t min_chunk_size = 256);
+
+    // Compute is only submitted in frames that asked for this
+    VkCommandBuffer GetComputeCommandBuffer();
+
+    // Graphics work at stage reads the results of this frame's compute. Only
+    // that stage waits, and frames without a dependency do not wait at all
+    void WaitForCompute(VkPipelineStageFlags stage);
+
+    // Submits the recorded compute work right away instead of with the
+    // frame, so that on an async compute queue it overlaps the graphics work
+    // of the previous frame
+    void SubmitCompute();
+
+    // Null with dynamic rendering, which has no framebuffers
     inline VkFramebuffer GetCurrentFramebuffer() const {
+        if (vk_framebuffers.empty()) {
+            return VK_NULL_HANDLE;
+        }
+
         return vk_framebuffers[current_framebuffer];
     }
+
+    inline VkImageView GetCurrentImageView() const {
+        return vk_image_views[current_framebuffer];
+    }
 };
 
 inline Renderer renderer;
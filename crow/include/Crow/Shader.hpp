@@ -1,22 +1,182 @@
 #ifndef CROW_SHADER_HPP
 #define CROW_SHADER_HPP
 
+#include <Crow/ShaderReflection.hpp>
 #include <Crow/Vulkan.hpp>
 
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <future>
 #include <optional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 
+struct shaderc_compile_options;
+
 namespace crow {
 
+enum class ShaderOptimization { Zero, Size, Performance };
+
+enum class ShaderTargetEnv { Vulkan1_1, Vulkan1_2, Vulkan1_3 };
+
+struct ShaderCompileSettings {
+    bool gen_debug = false;
+    ShaderOptimization optimization = ShaderOptimization::Performance;
+    ShaderTargetEnv target_env = ShaderTargetEnv::Vulkan1_2;
+};
+
+struct ShaderDefine {
+    std::string name;
+    std::string value;
+};
+
+struct ShaderCompileJob {
+    std::string file_name;
+    std::string code;
+    VkShaderStageFlagBits stage;
+    std::vector<ShaderDefine> defines;
+    std::string include_path;
+    ShaderCompileSettings settings;
+};
+
+// Long lived compiler context. The shaderc options for every combination of
+// settings are built once up front, and each thread gets its own shaderc
+// compiler, so Compile only has to clone a template and compile. Building
+// with CROW_NO_SHADERC leaves shaderc out and every compile fails, shipping
+// builds load their shaders from a ShaderArchive instead
+class ShaderCompiler {
+  private:
+    static constexpr size_t optimization_count = 3;
+    static constexpr size_t target_env_count = 3;
+    static constexpr size_t template_count =
+        2 * optimization_count * target_env_count;
+
+    std::array<shaderc_compile_options*, template_count> templates;
+
+    static size_t GetTemplateIndex(const ShaderCompileSettings& settings);
+
+  public:
+    ShaderCompiler();
+
+    ShaderCompiler(const ShaderCompiler&) = delete;
+    ShaderCompiler& operator=(const ShaderCompiler&) = delete;
+
+    ~ShaderCompiler();
+
+    std::vector<uint32_t>
+    Compile(const std::string& file_name, const std::string& code,
+            VkShaderStageFlagBits stage, const std::string& include_path,
+            const ShaderCompileSettings& settings,
+            const std::vector<ShaderDefine>& defines = {}) const;
+
+    // Compiles every job on the thread pool. The futures are in the same
+    // order as the jobs
+    std::vector<std::future<std::vector<uint32_t>>>
+    CompileBatch(std::vector<ShaderCompileJob> jobs) const;
+
+    // Same as above, but on_complete is called from the worker thread with
+    // the index of the job as soon as it finishes
+    void CompileBatch(
+        std::vector<ShaderCompileJob> jobs,
+        std::function<void(size_t, std::vector<uint32_t>)> on_complete) const;
+};
+
+inline ShaderCompiler shader_compiler;
+
 std::vector<uint32_t> CompileGLSLShader(const std::string& file_name,
                                         const std::string& code,
                                         VkShaderStageFlagBits stage,
                                         const std::string& include_path,
                                         bool gen_debug = false);
 
+// Picks the stage from the usual glslang extensions (.vert, .frag, .comp...)
+std::optional<VkShaderStageFlagBits>
+GetShaderStageFromPath(const std::filesystem::path& path);
+
 std::optional<VkShaderModule>
-CreateShaderFromSPIR_V(const std::vector<uint32_t>& spir_v);
+CreateShaderFromSPIR_V(std::span<const uint32_t> spir_v);
+
+// Specialization constant values for one shader stage. Constants that are not
+// set keep the value the shader was compiled with
+class ShaderSpecialization {
+  private:
+    std::vector<VkSpecializationMapEntry> entries;
+    std::vector<std::byte> data;
+    VkSpecializationInfo info{};
+
+    void SetBytes(uint32_t constant_id, const void* value, size_t size);
+
+  public:
+    template <typename T>
+    inline void Set(uint32_t constant_id, const T& value) {
+        static_assert(std::is_arithmetic_v<T>,
+                      "Specialization constants must be scalars");
+
+        if constexpr (std::is_same_v<T, bool>) {
+            VkBool32 bool_value = value ? VK_TRUE : VK_FALSE;
+            SetBytes(constant_id, &bool_value, sizeof(bool_value));
+        } else {
+            SetBytes(constant_id, &value, sizeof(value));
+        }
+    }
+
+    // Looks the constant up by name, fails if the shader has no such constant
+    // or it has a different size
+    template <typename T>
+    inline bool Set(const ShaderReflection& reflection, std::string_view name,
+                    const T& value) {
+        for (auto& constant : reflection.specialization_constants) {
+            if (constant.name != name) {
+                continue;
+            }
+
+            auto size = std::is_same_v<T, bool> ? sizeof(VkBool32) : sizeof(T);
+            if (constant.size != size) {
+                return false;
+            }
+
+            Set(constant.constant_id, value);
+            return true;
+        }
+
+        return false;
+    }
+
+    // Checks every value against the constants the shader declares
+    bool Validate(const ShaderReflection& reflection) const;
+
+    inline bool IsEmpty() const { return entries.empty(); }
+
+    uint64_t GetHash() const;
+
+    // Points into this object, nullptr when nothing is set
+    const VkSpecializationInfo* GetInfo();
+};
+
+// A module and everything needed to put it into a pipeline
+struct ShaderStage {
+    VkShaderStageFlagBits stage;
+    VkShaderModule module;
+    // Hash of the SPIR-V. Pipelines are keyed on it rather than the handle,
+    // which can be reused once the module is destroyed
+    uint64_t hash = 0;
+    std::string entry_point = "main";
+    ShaderSpecialization specialization;
+
+    // The create info points into this stage, so it has to outlive the
+    // pipeline creation
+    VkPipelineShaderStageCreateInfo GetCreateInfo();
+};
+
+// Creates the module and fills in the stage and entry point from reflection
+std::optional<ShaderStage>
+CreateShaderStageFromSPIR_V(std::span<const uint32_t> spir_v);
 
 } // namespace crow
 
@@ -0,0 +1,69 @@
+#ifndef CROW_SHADER_ARCHIVE_HPP
+#define CROW_SHADER_ARCHIVE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace crow {
+
+// Read only view of a shader archive built by crowshaderc. The file is
+// memory mapped and the SPIR-V returned by Find points straight into it, so
+// it stays valid until the archive is closed
+class ShaderArchive {
+  private:
+    const std::byte* data = nullptr;
+    size_t size = 0;
+
+#ifdef _WIN32
+    void* file_handle = nullptr;
+    void* mapping_handle = nullptr;
+#endif
+
+  public:
+    ShaderArchive() = default;
+
+    ShaderArchive(const ShaderArchive&) = delete;
+    ShaderArchive& operator=(const ShaderArchive&) = delete;
+
+    ~ShaderArchive();
+
+    bool Open(const std::filesystem::path& path);
+    void Close();
+
+    inline bool IsOpen() const { return data != nullptr; }
+
+    std::optional<std::span<const uint32_t>> Find(std::string_view name) const;
+
+    size_t GetEntryCount() const;
+
+    // Point into the archive like the SPIR-V does
+    std::vector<std::string_view> GetNames() const;
+};
+
+inline ShaderArchive shader_archive;
+
+class ShaderArchiveWriter {
+  private:
+    struct Entry {
+        std::string name;
+        std::vector<uint32_t> spir_v;
+    };
+
+    std::vector<Entry> entries;
+
+  public:
+    // Fails if an entry with the same name was already added
+    bool Add(std::string name, std::vector<uint32_t> spir_v);
+
+    bool Write(const std::filesystem::path& path) const;
+};
+
+} // namespace crow
+
+#endif
\ No newline at end of file
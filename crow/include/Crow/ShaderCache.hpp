@@ -0,0 +1,94 @@
+#ifndef CROW_SHADER_CACHE_HPP
+#define CROW_SHADER_CACHE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace crow {
+
+struct ShaderCacheDependency {
+    std::string path;
+    uint64_t content_hash;
+};
+
+struct ShaderCacheEntry {
+    std::vector<uint32_t> spir_v;
+    std::vector<ShaderCacheDependency> dependencies;
+};
+
+// Returns the current content hash of a dependency, or nothing if it is gone
+using ShaderCacheDependencyHasher =
+    std::function<std::optional<uint64_t>(const std::string&)>;
+
+struct ShaderCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t entry_count;
+    uint64_t total_size;
+};
+
+// Content addressed SPIR-V cache. Entries are keyed by everything that goes
+// into a compile except the included files, whose paths and content hashes
+// are stored in the entry and revalidated on load
+class ShaderCache {
+  private:
+    struct Entry {
+        uint64_t size;
+        uint64_t last_use;
+    };
+
+    std::filesystem::path directory;
+    uint64_t max_size = 0;
+    uint64_t total_size = 0;
+    uint64_t use_counter = 0;
+    uint64_t temp_counter = 0;
+
+    std::unordered_map<uint64_t, Entry> entries;
+    mutable std::mutex mutex;
+
+    std::atomic<uint64_t> hits = 0;
+    std::atomic<uint64_t> misses = 0;
+    std::atomic<uint64_t> evictions = 0;
+
+    std::filesystem::path GetEntryPath(uint64_t key) const;
+    void Evict();
+
+  public:
+    static constexpr uint64_t default_max_size = 256ull * 1024 * 1024;
+
+    bool Open(const std::filesystem::path& directory,
+              uint64_t max_size = default_max_size);
+    void Close();
+
+    inline bool IsOpen() const {
+        std::lock_guard lock{mutex};
+        return !directory.empty();
+    }
+
+    // Without a hasher the dependencies are hashed straight from disk
+    std::optional<ShaderCacheEntry>
+    Load(uint64_t key, const ShaderCacheDependencyHasher& hasher = {});
+    void Store(uint64_t key, const std::vector<uint32_t>& spir_v,
+               const std::vector<ShaderCacheDependency>& dependencies);
+
+    void Clear();
+
+    ShaderCacheStats GetStats() const;
+};
+
+// Shipping builds have no compiler whose output could be cached
+#ifndef CROW_NO_SHADERC
+inline ShaderCache shader_cache;
+#endif
+
+} // namespace crow
+
+#endif
\ No newline at end of file
@@ -0,0 +1,109 @@
+#ifndef CROW_SHADER_HOT_RELOAD_HPP
+#define CROW_SHADER_HOT_RELOAD_HPP
+
+#include <Crow/Shader.hpp>
+#include <Crow/Vulkan.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace crow {
+
+using ShaderWatchHandle = uint32_t;
+
+// Called on the main thread at a frame boundary with the recompiled module,
+// after the pipelines built from the old SPIR-V were invalidated. The
+// callback takes ownership of the module
+using ShaderReloadCallback = std::function<void(
+    VkShaderModule module, const std::vector<uint32_t>& spir_v)>;
+
+// Watches shader sources and everything they include. Changed shaders are
+// recompiled and turned into modules on the thread pool, and handed back
+// through ApplyPendingReloads so that the frame loop never waits on them
+class ShaderHotReloader {
+  private:
+    struct WatchedShader {
+        std::string file_name;
+        std::string normalized_name;
+        VkShaderStageFlagBits stage;
+        std::string include_path;
+        ShaderCompileSettings settings;
+        std::vector<ShaderDefine> defines;
+        ShaderReloadCallback on_reload;
+        // Hash of the SPIR-V in use, its pipelines are invalidated on reload
+        uint64_t hash;
+        // Reloads are numbered when queued. Compiles can finish out of
+        // order, so one older than the last applied reload is dropped
+        uint64_t sequence = 0;
+        uint64_t applied = 0;
+    };
+
+    struct PendingReload {
+        ShaderWatchHandle handle;
+        uint64_t sequence;
+        VkShaderModule module;
+        std::vector<uint32_t> spir_v;
+    };
+
+    std::unordered_map<ShaderWatchHandle, WatchedShader> shaders;
+    ShaderWatchHandle next_handle = 1;
+    std::mutex shaders_mutex;
+
+    std::vector<PendingReload> pending;
+    // Compile jobs still on the thread pool, Stop waits for them
+    size_t in_flight = 0;
+    std::mutex pending_mutex;
+    std::condition_variable idle;
+
+    std::thread thread;
+    std::atomic<bool> running = false;
+
+    std::vector<std::string> GetWatchedFiles();
+    void OnFilesChanged(const std::vector<std::string>& paths);
+    std::optional<PendingReload> Reload(ShaderWatchHandle handle,
+                                        const WatchedShader& shader);
+    void WatchLoop();
+
+  public:
+    ShaderHotReloader() = default;
+
+    ShaderHotReloader(const ShaderHotReloader&) = delete;
+    ShaderHotReloader& operator=(const ShaderHotReloader&) = delete;
+
+    ~ShaderHotReloader();
+
+    ShaderWatchHandle Watch(const std::string& file_name,
+                            VkShaderStageFlagBits stage,
+                            const std::string& include_path,
+                            const ShaderCompileSettings& settings,
+                            std::vector<ShaderDefine> defines,
+                            std::span<const uint32_t> spir_v,
+                            ShaderReloadCallback on_reload);
+    void Unwatch(ShaderWatchHandle handle);
+
+    void Start();
+    void Stop();
+
+    inline bool IsRunning() const { return running; }
+
+    // Must be called on the main thread between frames
+    void ApplyPendingReloads();
+};
+
+// Shipping builds load their shaders from an archive and never reload them
+#ifndef CROW_NO_SHADERC
+inline ShaderHotReloader shader_hot_reloader;
+#endif
+
+} // namespace crow
+
+#endif
\ No newline at end of file
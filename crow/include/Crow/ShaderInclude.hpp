@@ -0,0 +1,83 @@
+#ifndef CROW_SHADER_INCLUDE_HPP
+#define CROW_SHADER_INCLUDE_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace crow {
+
+struct ShaderIncludeFile {
+    std::string path;
+    std::string contents;
+    uint64_t content_hash;
+};
+
+// Resolves #include directives for the shader compiler. Included files are
+// kept in memory for the whole session, so shared headers are only read from
+// disk once, and the set of files each shader included is recorded so that
+// the shaders affected by a header change can be found
+class ShaderIncluder {
+  private:
+    std::vector<std::filesystem::path> include_directories;
+
+    std::unordered_map<std::string, std::shared_ptr<const ShaderIncludeFile>>
+        files;
+    mutable std::shared_mutex files_mutex;
+
+    // Per shader and variant, since defines can change what gets included
+    std::unordered_map<std::string,
+                       std::unordered_map<uint64_t, std::vector<std::string>>>
+        dependencies;
+    mutable std::mutex dependencies_mutex;
+
+    std::shared_ptr<const ShaderIncludeFile>
+    LoadFile(const std::filesystem::path& path);
+
+  public:
+    static constexpr size_t max_include_depth = 64;
+
+    static std::string NormalizePath(const std::filesystem::path& path);
+
+    void AddIncludeDirectory(const std::filesystem::path& directory);
+    void ClearIncludeDirectories();
+
+    // Must not be called while shaders are compiling
+    inline const std::vector<std::filesystem::path>&
+    GetIncludeDirectories() const {
+        return include_directories;
+    }
+
+    std::shared_ptr<const ShaderIncludeFile>
+    Resolve(const std::string& requested_source, bool relative,
+            const std::string& requesting_source,
+            const std::string& include_path);
+
+    std::optional<uint64_t> GetContentHash(const std::string& path);
+
+    // Drops the cached contents so that the next compile reads the file again
+    void Invalidate(const std::string& path);
+    void InvalidateAll();
+
+    // The variant identifies the defines and settings the shader was
+    // compiled with
+    void SetDependencies(const std::string& shader, uint64_t variant,
+                         std::vector<std::string> included);
+    // Every file any variant of the shader included
+    std::vector<std::string> GetDependencies(const std::string& shader) const;
+
+    // Every shader that included the file, directly or through another header
+    std::vector<std::string> GetDependents(const std::string& path) const;
+};
+
+inline ShaderIncluder shader_includer;
+
+} // namespace crow
+
+#endif
\ No newline at end of file
@@ -0,0 +1,71 @@
+#ifndef CROW_SHADER_MODULE_HPP
+#define CROW_SHADER_MODULE_HPP
+
+#include <Crow/Vulkan.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace crow {
+
+struct ShaderModule {
+    VkShaderModule module;
+    uint64_t hash;
+    std::vector<uint32_t> spir_v;
+};
+
+// The module is destroyed when the last reference goes away
+using ShaderModuleRef = std::shared_ptr<const ShaderModule>;
+
+struct ShaderModuleRegistryStats {
+    uint64_t live_modules;
+    // Bytes of SPIR-V held by live modules
+    uint64_t total_size;
+    // Acquires that returned an existing module
+    uint64_t shared;
+    uint64_t created;
+};
+
+// Hands out one module per unique SPIR-V blob
+class ShaderModuleRegistry {
+  private:
+    struct Entry {
+        std::weak_ptr<const ShaderModule> module;
+        const ShaderModule* pointer;
+    };
+
+    // Keyed by hash, the SPIR-V is compared on lookup in case of collisions
+    std::unordered_multimap<uint64_t, Entry> modules;
+    std::mutex mutex;
+
+    uint64_t total_size = 0;
+    uint64_t shared = 0;
+    uint64_t created = 0;
+
+    void Release(const ShaderModule* module);
+
+  public:
+    ShaderModuleRegistry() = default;
+
+    ShaderModuleRegistry(const ShaderModuleRegistry&) = delete;
+    ShaderModuleRegistry& operator=(const ShaderModuleRegistry&) = delete;
+
+    std::optional<ShaderModuleRef> Acquire(std::span<const uint32_t> spir_v);
+
+    ShaderModuleRegistryStats GetStats();
+
+    // Destroys every module that is still referenced, the references stay
+    // valid objects but their handles must no longer be used
+    void Destroy();
+};
+
+inline ShaderModuleRegistry shader_module_registry;
+
+} // namespace crow
+
+#endif
\ No newline at end of file
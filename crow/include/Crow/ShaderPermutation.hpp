@@ -0,0 +1,116 @@
+#ifndef CROW_SHADER_PERMUTATION_HPP
+#define CROW_SHADER_PERMUTATION_HPP
+
+#include <Crow/Shader.hpp>
+#include <Crow/Vulkan.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace crow {
+
+// One preprocessor macro and the values it can take, the first value is the
+// default
+struct ShaderPermutationAxis {
+    std::string name;
+    std::vector<std::string> values;
+};
+
+// Index of the chosen value of every axis, packed as a mixed radix number
+using ShaderVariantKey = uint64_t;
+
+struct ShaderVariantRecord {
+    std::string file_name;
+    VkShaderStageFlagBits stage;
+    std::vector<ShaderDefine> defines;
+};
+
+// Keeps track of every variant that was requested during the session, so
+// that shipping builds can precompile exactly those
+class ShaderVariantManifest {
+  private:
+    std::vector<ShaderVariantRecord> records;
+    std::unordered_set<uint64_t> recorded;
+    mutable std::mutex mutex;
+
+  public:
+    void Record(const std::string& file_name, VkShaderStageFlagBits stage,
+                const std::vector<ShaderDefine>& defines);
+
+    std::vector<ShaderVariantRecord> GetRecords() const;
+
+    bool Write(const std::filesystem::path& path) const;
+    static std::optional<std::vector<ShaderVariantRecord>>
+    Read(const std::filesystem::path& path);
+};
+
+inline ShaderVariantManifest shader_variant_manifest;
+
+// The name crowshaderc stores a variant under in a shader archive
+std::string GetShaderVariantName(const std::string& file_name,
+                                 const std::vector<ShaderDefine>& defines);
+
+class ShaderPermutation {
+  private:
+    std::string file_name;
+    std::string code;
+    VkShaderStageFlagBits stage;
+    std::string include_path;
+    ShaderCompileSettings settings;
+
+    std::vector<ShaderPermutationAxis> axes;
+
+    std::unordered_map<ShaderVariantKey,
+                       std::shared_future<std::vector<uint32_t>>>
+        variants;
+    mutable std::mutex mutex;
+
+  public:
+    ShaderPermutation(const std::string& file_name, const std::string& code,
+                      VkShaderStageFlagBits stage,
+                      const std::string& include_path,
+                      std::vector<ShaderPermutationAxis> axes,
+                      const ShaderCompileSettings& settings = {});
+
+    ShaderPermutation(const ShaderPermutation&) = delete;
+    ShaderPermutation& operator=(const ShaderPermutation&) = delete;
+
+    // Waits for the variants still compiling, they read this permutation
+    ~ShaderPermutation();
+
+    // Axes that are not in the selection use their default value
+    std::optional<ShaderVariantKey>
+    GetVariantKey(const std::vector<ShaderDefine>& selection) const;
+
+    // Nothing is returned for keys past GetVariantCount
+    std::optional<std::vector<ShaderDefine>>
+    GetDefines(ShaderVariantKey key) const;
+
+    // Starts compiling the variant on the thread pool if it has not been
+    // requested before, unless the open shader archive already has it. An
+    // invalid key gives empty SPIR-V, like a failed compile
+    std::shared_future<std::vector<uint32_t>>
+    RequestVariant(ShaderVariantKey key);
+
+    // Blocks until the variant is compiled
+    inline std::vector<uint32_t> GetVariant(ShaderVariantKey key) {
+        return RequestVariant(key).get();
+    }
+
+    // Requests every variant of this shader that is listed in a manifest
+    void Precompile(const std::vector<ShaderVariantRecord>& records);
+
+    uint64_t GetVariantCount() const;
+    size_t GetCompiledVariantCount() const;
+};
+
+} // namespace crow
+
+#endif
\ No newline at end of file
@@ -0,0 +1,68 @@
+#ifndef CROW_SHADER_REFLECTION_HPP
+#define CROW_SHADER_REFLECTION_HPP
+
+#include <Crow/Vulkan.hpp>
+
+#include <array>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace crow {
+
+struct ShaderDescriptorBinding {
+    uint32_t set;
+    uint32_t binding;
+    VkDescriptorType type;
+    uint32_t count;
+    std::string name;
+};
+
+struct ShaderVertexInput {
+    uint32_t location;
+    VkFormat format;
+    std::string name;
+};
+
+enum class ShaderSpecializationType { Bool, Int, UInt, Float };
+
+struct ShaderSpecializationConstant {
+    uint32_t constant_id;
+    ShaderSpecializationType type;
+    // In bytes, bools are passed as a VkBool32
+    uint32_t size;
+    // Raw bits of the value the shader was compiled with
+    uint64_t default_value;
+    std::string name;
+};
+
+struct ShaderReflection {
+    VkShaderStageFlagBits stage;
+    std::string entry_point;
+
+    std::vector<ShaderDescriptorBinding> descriptor_bindings;
+    std::optional<VkPushConstantRange> push_constant_range;
+    std::vector<ShaderVertexInput> vertex_inputs;
+    std::vector<ShaderSpecializationConstant> specialization_constants;
+
+    // Only set for compute, task and mesh shaders
+    std::array<uint32_t, 3> workgroup_size{0, 0, 0};
+};
+
+std::optional<ShaderReflection>
+ReflectSPIR_V(std::span<const uint32_t> spir_v);
+
+// The combined layout of every stage of a pipeline. sets is indexed by the
+// descriptor set number, unused set numbers below the highest one are empty
+struct PipelineLayoutDescription {
+    std::vector<std::vector<VkDescriptorSetLayoutBinding>> sets;
+    std::vector<VkPushConstantRange> push_constant_ranges;
+};
+
+PipelineLayoutDescription
+MergeShaderReflections(std::span<const ShaderReflection> stages);
+
+} // namespace crow
+
+#endif
\ No newline at end of file
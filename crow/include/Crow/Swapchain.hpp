@@ -0,0 +1,57 @@
+#ifndef CROW_SWAPCHAIN_HPP
+#define CROW_SWAPCHAIN_HPP
+
+#include <Crow/Vulkan.hpp>
+
+#include <cstdint>
+#include <optional>
+
+namespace crow {
+
+// Owns the swapchain and everything sized by it. On resize the swapchain is
+// rebuilt from the old one and the old resources go to the deletion queue,
+// so nothing waits for the device to idle
+class SwapchainManager {
+  private:
+    uint32_t min_image_count = 3;
+    uint32_t width = 0, height = 0;
+    bool out_of_date = false;
+
+    static std::optional<VkRenderPass> CreateRenderPass(bool load);
+    bool CreateRenderPasses();
+    bool CreateImageResources();
+
+    // Hands the current image resources to the deletion queue
+    static void RetireImageResources();
+
+  public:
+    SwapchainManager() = default;
+
+    SwapchainManager(const SwapchainManager&) = delete;
+    SwapchainManager& operator=(const SwapchainManager&) = delete;
+
+    bool Create(uint32_t min_image_count, uint32_t width, uint32_t height);
+
+    inline void Resize(uint32_t width, uint32_t height) {
+        this->width = width;
+        this->height = height;
+        out_of_date = true;
+    }
+
+    // Acquire or present reported that the swapchain no longer matches
+    inline void Invalidate() { out_of_date = true; }
+    inline bool IsOutOfDate() const { return out_of_date; }
+
+    inline bool IsMinimized() const { return width == 0 || height == 0; }
+
+    // Fails while the window is minimized
+    bool Recreate();
+
+    void Destroy();
+};
+
+inline SwapchainManager swapchain_manager;
+
+} // namespace crow
+
+#endif
\ No newline at end of file
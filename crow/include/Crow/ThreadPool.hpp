@@ -0,0 +1,62 @@
+#ifndef CROW_THREAD_POOL_HPP
+#define CROW_THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace crow {
+
+class ThreadPool {
+  private:
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()>> tasks;
+
+    std::mutex mutex;
+    std::condition_variable condition;
+
+    size_t thread_count;
+    bool stopping = false;
+
+    void WorkerLoop();
+
+  public:
+    // A thread count of 0 uses one thread per core, minus the main thread
+    explicit ThreadPool(size_t thread_count = 0);
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool();
+
+    void Enqueue(std::function<void()> task);
+
+    template <typename F>
+    auto Submit(F&& func) -> std::future<std::invoke_result_t<F>> {
+        using Result = std::invoke_result_t<F>;
+
+        // std::function needs a copyable target, packaged_task is move only
+        auto task = std::make_shared<std::packaged_task<Result()>>(
+            std::forward<F>(func));
+        auto future = task->get_future();
+
+        Enqueue([task]() { (*task)(); });
+
+        return future;
+    }
+
+    inline size_t GetThreadCount() const { return thread_count; }
+};
+
+inline ThreadPool thread_pool;
+
+} // namespace crow
+
+#endif
\ No newline at end of file
@@ -0,0 +1,49 @@
+#ifndef CROW_TIMELINE_HPP
+#define CROW_TIMELINE_HPP
+
+#include <Crow/Vulkan.hpp>
+
+#include <atomic>
+#include <cstdint>
+
+namespace crow {
+
+// A timeline semaphore owned by one queue. Each submission to the queue
+// signals a new value, so waiting for or polling a value tracks that
+// submission without a fence
+class QueueTimeline {
+  private:
+    VkSemaphore semaphore = VK_NULL_HANDLE;
+    std::atomic<uint64_t> last_submitted = 0;
+
+  public:
+    QueueTimeline() = default;
+
+    QueueTimeline(const QueueTimeline&) = delete;
+    QueueTimeline& operator=(const QueueTimeline&) = delete;
+
+    bool Create();
+    void Destroy();
+
+    inline VkSemaphore Get() const { return semaphore; }
+
+    // Reserves the value the next submission will signal
+    inline uint64_t Next() { return ++last_submitted; }
+    inline uint64_t GetLastSubmitted() const { return last_submitted; }
+
+    // Does not block
+    uint64_t GetCompleted() const;
+    inline bool IsComplete(uint64_t value) const {
+        return GetCompleted() >= value;
+    }
+
+    bool Wait(uint64_t value, uint64_t timeout = UINT64_MAX) const;
+};
+
+inline QueueTimeline graphics_timeline;
+inline QueueTimeline compute_timeline;
+inline QueueTimeline transfer_timeline;
+
+} // namespace crow
+
+#endif
\ No newline at end of file
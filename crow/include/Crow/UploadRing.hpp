@@ -0,0 +1,85 @@
+#ifndef CROW_UPLOAD_RING_HPP
+#define CROW_UPLOAD_RING_HPP
+
+#include <Crow/Allocator.hpp>
+#include <Crow/Vulkan.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace crow {
+
+// Only valid for the frame it was allocated in
+struct UploadAllocation {
+    VkBuffer buffer;
+    // The dynamic offset when bound as a dynamic uniform or storage buffer
+    uint32_t offset;
+    VkDeviceSize size;
+    void* data;
+};
+
+// Memory for data the CPU writes every frame, like uniforms and dynamic
+// geometry. Each frame in flight has a persistently mapped buffer that is
+// bump allocated, and starts over once the GPU is done with that frame, so
+// an allocation is an atomic add and uploading is a memcpy
+class UploadRing {
+  private:
+    std::vector<Buffer> frames;
+    VkDeviceSize capacity = 0;
+    // Large enough for uniform and storage buffer offsets
+    VkDeviceSize min_alignment = 1;
+    bool coherent = true;
+
+    std::atomic<VkDeviceSize> head = 0;
+    VkDeviceSize flushed = 0;
+    VkDeviceSize peak = 0;
+
+  public:
+    UploadRing() = default;
+
+    UploadRing(const UploadRing&) = delete;
+    UploadRing& operator=(const UploadRing&) = delete;
+
+    // Capacity is per frame in flight
+    bool Create(VkDeviceSize capacity);
+    void Destroy();
+
+    // Called at the start of a frame, after waiting for the frame in flight
+    void ResetFrame();
+
+    // Makes everything written so far visible to the GPU, called before
+    // submitting work that reads it
+    void Flush();
+
+    // Safe to call from several threads. Fails when the frame is full. The
+    // offset is a multiple of both alignment and the device's minimum
+    std::optional<UploadAllocation> Allocate(VkDeviceSize size,
+                                             VkDeviceSize alignment = 0);
+
+    std::optional<UploadAllocation> Upload(const void* data, VkDeviceSize size,
+                                           VkDeviceSize alignment = 0);
+
+    template <typename T>
+    inline std::optional<UploadAllocation> Push(const T& value) {
+        return Upload(&value, sizeof(T));
+    }
+
+    // For writing the descriptor sets of each frame in flight
+    inline VkBuffer GetBuffer(size_t frame) const {
+        return frames[frame].buffer;
+    }
+
+    inline VkDeviceSize GetCapacity() const { return capacity; }
+    inline VkDeviceSize GetUsed() const { return head; }
+    // Most used in a single frame
+    inline VkDeviceSize GetPeak() const { return peak; }
+};
+
+inline UploadRing upload_ring;
+
+} // namespace crow
+
+#endif
\ No newline at end of file
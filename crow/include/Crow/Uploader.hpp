@@ -0,0 +1,148 @@
+#ifndef CROW_UPLOADER_HPP
+#define CROW_UPLOADER_HPP
+
+#include <Crow/Allocator.hpp>
+#include <Crow/Vulkan.hpp>
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace crow {
+
+// The queue that uses an uploaded resource, ownership of it is moved from
+// the transfer queue family to that queue's family
+enum class UploadQueue { Graphics, Compute };
+
+using UploadCallback = std::function<void()>;
+
+// Streams buffer and image data to the GPU on the dedicated transfer queue,
+// so large uploads neither wait for nor hold up the frame. Uploads are staged
+// and recorded into a batch, which is submitted on its own without waiting on
+// any other queue. Once a batch is done, its resources are acquired by the
+// queue that uses them at the start of that queue's next command buffer. The
+// batch completes and its callbacks run at the first frame after every
+// acquire was submitted. Resources must use VK_SHARING_MODE_EXCLUSIVE.
+// Ownership only ever moves away from the transfer queue, so a resource can
+// only be uploaded to while freshly created, before any queue has used it
+class Uploader {
+  private:
+    struct Acquires {
+        std::vector<VkBufferMemoryBarrier> buffers;
+        std::vector<VkImageMemoryBarrier> images;
+    };
+
+    struct Batch {
+        uint64_t value;
+        VkCommandBuffer cmd;
+        // Without timeline semaphores
+        VkFence fence;
+
+        std::vector<Buffer> staging;
+        VkDeviceSize staged_size;
+
+        Acquires releases;
+        Acquires graphics_acquires;
+        Acquires compute_acquires;
+        std::vector<UploadCallback> callbacks;
+    };
+
+    struct Acquiring {
+        uint64_t value;
+        // Batches without compute acquires start out recorded
+        bool compute_recorded;
+        std::vector<UploadCallback> callbacks;
+    };
+
+    VkCommandPool cmd_pool = VK_NULL_HANDLE;
+
+    std::optional<Batch> recording;
+    // Finish in submission order
+    std::deque<Batch> in_flight;
+
+    std::vector<VkCommandBuffer> free_cmds;
+    std::vector<VkFence> free_fences;
+
+    // Done on the transfer queue but waiting for compute to be recorded
+    Acquires compute_pending;
+
+    // Batches whose acquires are recorded but not yet known to be submitted,
+    // completed in submission order
+    std::deque<Acquiring> acquiring;
+
+    uint64_t last_submitted = 0;
+    uint64_t last_acquired = 0;
+
+    std::mutex mutex;
+
+    static std::optional<Buffer> Stage(const void* data, VkDeviceSize size);
+    static void RecordAcquires(VkCommandBuffer cmd, const Acquires& acquires);
+
+    // The mutex must be held
+    bool BeginBatch();
+    void AddToBatch(const Buffer& staging, UploadCallback callback);
+    std::optional<uint64_t> SubmitBatch();
+    bool IsBatchDone(const Batch& batch) const;
+    void FreeBatch(Batch& batch);
+
+  public:
+    Uploader() = default;
+
+    Uploader(const Uploader&) = delete;
+    Uploader& operator=(const Uploader&) = delete;
+
+    bool Create();
+    // The device must be idle
+    void Destroy();
+
+    // Safe to call from several threads. Returns the value of the batch the
+    // upload is in, or nothing when staging memory is out of budget and the
+    // upload should be tried again later. The buffer must not have been used
+    // by any queue yet, each range of it is uploaded to at most once
+    std::optional<uint64_t>
+    UploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data,
+                 VkDeviceSize size, UploadQueue queue = UploadQueue::Graphics,
+                 UploadCallback callback = {});
+
+    // Fills the first mip level and layer of an image that no queue has used
+    // yet, it is uploaded to at most once. Aspect is a single aspect, depth
+    // and stencil are not uploaded together
+    std::optional<uint64_t> UploadImage(
+        VkImage image, VkImageAspectFlags aspect, VkExtent3D extent,
+        const void* data, VkDeviceSize size,
+        VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        UploadQueue queue = UploadQueue::Graphics,
+        UploadCallback callback = {});
+
+    // Submits the uploads recorded so far, batches are also submitted once
+    // they are large enough and at the start of every frame
+    std::optional<uint64_t> Submit();
+
+    // Called at the start of a frame with the graphics command buffer.
+    // Acquires the resources of finished batches, and completes the batches
+    // whose acquires went out with the previous frame
+    void Update(VkCommandBuffer cmd);
+
+    // Called when the compute command buffer of a frame begins
+    void RecordComputeAcquires(VkCommandBuffer cmd);
+
+    // The batch is usable by the queues it was uploaded for
+    inline bool IsComplete(uint64_t value) {
+        std::lock_guard lock{mutex};
+        return value <= last_acquired;
+    }
+
+    inline size_t GetInFlightCount() {
+        std::lock_guard lock{mutex};
+        return in_flight.size();
+    }
+};
+
+inline Uploader uploader;
+
+} // namespace crow
+
+#endif
\ No newline at end of file
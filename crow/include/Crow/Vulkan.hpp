@@ -7,6 +7,7 @@
 
 #include <VkBootstrap.h>
 
+#include <cstdint>
 #include <vector>
 
 namespace crow {
@@ -14,6 +15,13 @@ namespace crow {
 inline vkb::Instance vkb_instance;
 inline vkb::Device vkb_device;
 
+// Optional device features, set when the device is created
+inline bool vk_graphics_pipeline_library = false;
+inline bool vk_timeline_semaphores = false;
+inline bool vk_synchronization2 = false;
+inline bool vk_dynamic_rendering = false;
+inline bool vk_memory_budget = false;
+
 inline VkSurfaceKHR vk_surface;
 
 inline VkQueue vk_graphics_queue;
@@ -21,21 +29,44 @@ inline VkQueue vk_compute_queue;
 inline VkQueue vk_present_queue;
 inline VkQueue vk_transfer_queue;
 
+// Resources shared between graphics and async compute need
+// VK_SHARING_MODE_CONCURRENT or an ownership transfer
+inline uint32_t vk_compute_queue_family = 0;
+inline bool vk_async_compute = false;
+
+// Always a family of its own, resources change ownership when used elsewhere
+inline uint32_t vk_transfer_queue_family = 0;
+
 inline vkb::Swapchain vkb_swapchain;
 
+// Frames the CPU may record ahead of the GPU. Per frame resources are sized
+// by this, per image resources by vkb_swapchain.image_count
+inline size_t vk_frames_in_flight = 2;
 inline size_t vk_frame_index = 0;
-
+// Frames submitted since startup
+inline uint64_t vk_frame_count = 0;
+
+// Every swapchain image uses the same render pass. With dynamic rendering
+// there is no render pass and no framebuffers, frames render straight to the
+// image views
+inline VkRenderPass vk_render_pass = VK_NULL_HANDLE;
+// Compatible with the one above, but keeps what earlier render graph passes
+// drew instead of clearing
+inline VkRenderPass vk_load_render_pass = VK_NULL_HANDLE;
+
+// Per swapchain image, the images are owned by the swapchain
+inline std::vector<VkImage> vk_images;
 inline std::vector<VkImageView> vk_image_views;
-inline std::vector<VkRenderPass> vk_render_passes;
 inline std::vector<VkFramebuffer> vk_framebuffers;
+inline std::vector<VkSemaphore> vk_render_finished_semaphores;
 
 inline VkCommandPool vk_graphics_cmd_pool;
 inline VkCommandPool vk_compute_cmd_pool;
 
+// Per frame in flight
 inline std::vector<VkCommandBuffer> vk_cmd_graphics;
 inline std::vector<VkCommandBuffer> vk_cmd_compute;
 
-inline std::vector<VkSemaphore> vk_render_finished_semaphores;
 inline std::vector<VkSemaphore> vk_image_available_semaphores;
 inline std::vector<VkFence> vk_graphics_flight_fences;
 
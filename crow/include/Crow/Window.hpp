@@ -3,6 +3,7 @@
 
 #include <Crow/Vulkan.hpp>
 #include <VkBootstrap.h>
+#include <cstdint>
 #include <optional>
 #include <string>
 #include <tuple>
@@ -19,7 +20,8 @@ class Window {
 
   public:
     Window(const std::string& title, size_t width, size_t height,
-           bool fullscreen);
+           bool fullscreen, size_t frames_in_flight = 2,
+           uint32_t swapchain_images = 3);
 
     Window(const Window&) = delete;
     Window(Window&& window)
@@ -67,6 +69,8 @@ class WindowBuilder {
     size_t width = 1280;
     size_t height = 720;
     bool fullscreen = false;
+    size_t frames_in_flight = 2;
+    uint32_t swapchain_images = 3;
 
   public:
     inline WindowBuilder& SetTitle(const std::string& title) {
@@ -83,8 +87,21 @@ class WindowBuilder {
 
     WindowBuilder& SetFullscreenSize(size_t width = 0, size_t height = 0);
 
+    // More frames in flight hide CPU spikes at the cost of input latency
+    inline WindowBuilder& SetFramesInFlight(size_t frames_in_flight) {
+        this->frames_in_flight = frames_in_flight;
+        return *this;
+    }
+
+    // A minimum, the driver may hand out more images than asked for
+    inline WindowBuilder& SetSwapchainImageCount(uint32_t swapchain_images) {
+        this->swapchain_images = swapchain_images;
+        return *this;
+    }
+
     inline std::optional<Window> Build() const {
-        Window window(title, width, height, fullscreen);
+        Window window(title, width, height, fullscreen, frames_in_flight,
+                      swapchain_images);
 
         if (!window.Valid()) {
             return {};
@@ -0,0 +1,322 @@
+#define VMA_IMPLEMENTATION
+#include <Crow/Allocator.hpp>
+
+#include <Crow/DeletionQueue.hpp>
+#include <Crow/Log.hpp>
+
+#include <algorithm>
+
+namespace crow {
+
+namespace {
+
+// Attachments at least this large get memory of their own, so that resizing
+// them does not leave holes in shared blocks
+constexpr VkDeviceSize dedicated_image_size = 16 * 1024 * 1024;
+
+constexpr VkDeviceSize pool_block_size = 32 * 1024 * 1024;
+
+constexpr VkDeviceSize mebibyte = 1024 * 1024;
+
+// VMA may not be told about a newer version than the instance was created
+// with or the device supports, and knows nothing past 1.3
+uint32_t GetAllocatorApiVersion() {
+    auto version = std::min({vkb_instance.api_version,
+                             vkb_device.physical_device.properties.apiVersion,
+                             VK_API_VERSION_1_3});
+
+    return VK_MAKE_API_VERSION(0, VK_API_VERSION_MAJOR(version),
+                               VK_API_VERSION_MINOR(version), 0);
+}
+
+} // namespace
+
+bool MemoryAllocator::CreatePool(VkBufferUsageFlags usage,
+                                 VmaAllocationCreateFlags flags,
+                                 VmaPool& pool) {
+    // Pools have one memory type, the one a typical buffer would get
+    VkBufferCreateInfo buffer_info{};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = 1024;
+    buffer_info.usage = usage;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VmaAllocationCreateInfo alloc_info{};
+    alloc_info.usage = VMA_MEMORY_USAGE_AUTO;
+    alloc_info.flags = flags;
+
+    uint32_t memory_type;
+    if (vmaFindMemoryTypeIndexForBufferInfo(allocator, &buffer_info,
+                                            &alloc_info,
+                                            &memory_type) != VK_SUCCESS) {
+        println("No memory type for memory pool");
+        return false;
+    }
+
+    VmaPoolCreateInfo pool_info{};
+    pool_info.memoryTypeIndex = memory_type;
+    pool_info.blockSize = pool_block_size;
+
+    if (vmaCreatePool(allocator, &pool_info, &pool) != VK_SUCCESS) {
+        println("Could not create memory pool");
+        pool = VK_NULL_HANDLE;
+        return false;
+    }
+
+    return true;
+}
+
+bool MemoryAllocator::Create() {
+    VmaAllocatorCreateInfo allocator_info{};
+    allocator_info.physicalDevice = vkb_device.physical_device.physical_device;
+    allocator_info.device = vkb_device.device;
+    allocator_info.instance = vkb_instance.instance;
+    allocator_info.pAllocationCallbacks = vkb_device.allocation_callbacks;
+    allocator_info.vulkanApiVersion = GetAllocatorApiVersion();
+
+    // The budget extension needs 1.1 for the properties it is queried with
+    if (vk_memory_budget &&
+        allocator_info.vulkanApiVersion >= VK_API_VERSION_1_1) {
+        allocator_info.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+    }
+
+    if (vmaCreateAllocator(&allocator_info, &allocator) != VK_SUCCESS) {
+        println("Could not create memory allocator");
+        allocator = VK_NULL_HANDLE;
+        return false;
+    }
+
+    if (!CreatePool(VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                    VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+                        VMA_ALLOCATION_CREATE_MAPPED_BIT,
+                    staging_pool) ||
+        !CreatePool(VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                    VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT |
+                        VMA_ALLOCATION_CREATE_MAPPED_BIT,
+                    readback_pool)) {
+        Destroy();
+        return false;
+    }
+
+    over_budget = false;
+    return true;
+}
+
+void MemoryAllocator::Destroy() {
+    if (staging_pool != VK_NULL_HANDLE) {
+        vmaDestroyPool(allocator, staging_pool);
+        staging_pool = VK_NULL_HANDLE;
+    }
+
+    if (readback_pool != VK_NULL_HANDLE) {
+        vmaDestroyPool(allocator, readback_pool);
+        readback_pool = VK_NULL_HANDLE;
+    }
+
+    if (allocator != VK_NULL_HANDLE) {
+        vmaDestroyAllocator(allocator);
+        allocator = VK_NULL_HANDLE;
+    }
+}
+
+void MemoryAllocator::NewFrame() {
+    vmaSetCurrentFrameIndex(allocator, uint32_t(vk_frame_count));
+
+    auto heaps = GetHeapStats();
+
+    bool over = false;
+    for (auto& heap : heaps) {
+        over = over || heap.usage > heap.budget;
+    }
+
+    // Only reported when it starts
+    if (over && !over_budget) {
+        for (size_t i = 0; i < heaps.size(); i++) {
+            println("GPU memory heap {}: {} of {} MiB used", i,
+                    heaps[i].usage / mebibyte, heaps[i].budget / mebibyte);
+        }
+
+        println("GPU memory is over budget");
+    }
+
+    over_budget = over;
+}
+
+std::optional<Buffer> MemoryAllocator::CreateBuffer(
+    VkDeviceSize size, VkBufferUsageFlags usage, MemoryUsage memory_usage) {
+    VmaAllocationCreateInfo alloc_info{};
+    alloc_info.usage = VMA_MEMORY_USAGE_AUTO;
+
+    switch (memory_usage) {
+    case MemoryUsage::Device:
+        alloc_info.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+        break;
+    case MemoryUsage::Upload:
+        alloc_info.flags =
+            VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+            VMA_ALLOCATION_CREATE_MAPPED_BIT;
+        break;
+    case MemoryUsage::Staging:
+        // Streaming can wait, going over budget makes the driver page
+        alloc_info.flags =
+            VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+            VMA_ALLOCATION_CREATE_MAPPED_BIT |
+            VMA_ALLOCATION_CREATE_WITHIN_BUDGET_BIT;
+        alloc_info.pool = staging_pool;
+        usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        break;
+    case MemoryUsage::Readback:
+        alloc_info.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT |
+                           VMA_ALLOCATION_CREATE_MAPPED_BIT;
+        alloc_info.pool = readback_pool;
+        usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        break;
+    }
+
+    VkBufferCreateInfo buffer_info{};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = size;
+    buffer_info.usage = usage;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    Buffer buffer{};
+    buffer.size = size;
+
+    VmaAllocationInfo info;
+    if (vmaCreateBuffer(allocator, &buffer_info, &alloc_info, &buffer.buffer,
+                        &buffer.allocation, &info) != VK_SUCCESS) {
+        println("Could not create a {} byte buffer", size);
+        return {};
+    }
+
+    buffer.data = info.pMappedData;
+    return buffer;
+}
+
+std::optional<Image>
+MemoryAllocator::CreateImage(const VkImageCreateInfo& image_info) {
+    Image image{};
+
+    if (vkCreateImage(vkb_device.device, &image_info,
+                      vkb_device.allocation_callbacks,
+                      &image.image) != VK_SUCCESS) {
+        println("Could not create image");
+        return {};
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(vkb_device.device, image.image,
+                                 &requirements);
+
+    VmaAllocationCreateInfo alloc_info{};
+    alloc_info.preferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+    bool attachment = (image_info.usage &
+                       (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)) != 0;
+
+    if (attachment && requirements.size >= dedicated_image_size) {
+        alloc_info.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+        alloc_info.priority = 1.0f;
+    }
+
+    if (vmaAllocateMemoryForImage(allocator, image.image, &alloc_info,
+                                  &image.allocation, nullptr) != VK_SUCCESS) {
+        println("Could not allocate {} bytes for image", requirements.size);
+        vkDestroyImage(vkb_device.device, image.image,
+                       vkb_device.allocation_callbacks);
+        return {};
+    }
+
+    if (vmaBindImageMemory(allocator, image.allocation, image.image) !=
+        VK_SUCCESS) {
+        println("Could not bind image memory");
+        vmaFreeMemory(allocator, image.allocation);
+        vkDestroyImage(vkb_device.device, image.image,
+                       vkb_device.allocation_callbacks);
+        return {};
+    }
+
+    return image;
+}
+
+std::optional<VmaAllocation>
+MemoryAllocator::AllocateMemory(const VkMemoryRequirements& requirements,
+                                bool dedicated) {
+    VmaAllocationCreateInfo alloc_info{};
+    alloc_info.preferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+    if (dedicated) {
+        alloc_info.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+        alloc_info.priority = 1.0f;
+    }
+
+    VmaAllocation allocation;
+    if (vmaAllocateMemory(allocator, &requirements, &alloc_info, &allocation,
+                          nullptr) != VK_SUCCESS) {
+        println("Could not allocate {} bytes", requirements.size);
+        return {};
+    }
+
+    return allocation;
+}
+
+void MemoryAllocator::DestroyBuffer(const Buffer& buffer) {
+    if (buffer.buffer != VK_NULL_HANDLE) {
+        vmaDestroyBuffer(allocator, buffer.buffer, buffer.allocation);
+    }
+}
+
+void MemoryAllocator::DestroyImage(const Image& image) {
+    if (image.image != VK_NULL_HANDLE) {
+        vmaDestroyImage(allocator, image.image, image.allocation);
+    }
+}
+
+void MemoryAllocator::FreeMemory(VmaAllocation allocation) {
+    if (allocation != VK_NULL_HANDLE) {
+        vmaFreeMemory(allocator, allocation);
+    }
+}
+
+void MemoryAllocator::ReleaseBuffer(const Buffer& buffer) {
+    deletion_queue.Push([this, buffer]() { DestroyBuffer(buffer); });
+}
+
+void MemoryAllocator::ReleaseImage(const Image& image) {
+    deletion_queue.Push([this, image]() { DestroyImage(image); });
+}
+
+void MemoryAllocator::ReleaseMemory(VmaAllocation allocation) {
+    deletion_queue.Push([this, allocation]() { FreeMemory(allocation); });
+}
+
+std::vector<HeapStats> MemoryAllocator::GetHeapStats() const {
+    VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+    vmaGetHeapBudgets(allocator, budgets);
+
+    const VkPhysicalDeviceMemoryProperties* properties;
+    vmaGetMemoryProperties(allocator, &properties);
+
+    std::vector<HeapStats> heaps;
+
+    for (uint32_t i = 0; i < properties->memoryHeapCount; i++) {
+        auto& budget = budgets[i];
+
+        HeapStats heap{};
+        heap.device_local = (properties->memoryHeaps[i].flags &
+                             VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+        heap.usage = budget.usage;
+        heap.budget = budget.budget;
+        heap.block_bytes = budget.statistics.blockBytes;
+        heap.allocation_bytes = budget.statistics.allocationBytes;
+        heap.blocks = budget.statistics.blockCount;
+        heap.allocations = budget.statistics.allocationCount;
+
+        heaps.push_back(heap);
+    }
+
+    return heaps;
+}
+
+} // namespace crow
\ No newline at end of file
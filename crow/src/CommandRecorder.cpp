@@ -0,0 +1,196 @@
+#include <Crow/CommandRecorder.hpp>
+
+#include <Crow/Log.hpp>
+#include <Crow/ThreadPool.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+
+namespace crow {
+
+namespace {
+
+// Shared with the helper tasks, which can start after Record returned when
+// the pool is busy with compiles
+struct ChunkQueue {
+    std::atomic<size_t> next = 0;
+    size_t done = 0;
+    std::mutex mutex;
+    std::condition_variable finished;
+};
+
+} // namespace
+
+std::optional<VkCommandBuffer> CommandRecorder::AllocateSecondary() {
+    ThreadPools* thread_pools;
+
+    {
+        std::lock_guard lock{mutex};
+
+        auto& entry = threads[std::this_thread::get_id()];
+        if (!entry) {
+            entry = std::make_unique<ThreadPools>();
+        }
+
+        thread_pools = entry.get();
+    }
+
+    // Only this thread touches its pools while recording
+    if (thread_pools->frames.size() < vk_frames_in_flight) {
+        thread_pools->frames.resize(vk_frames_in_flight);
+    }
+
+    auto& frame = thread_pools->frames[vk_frame_index];
+
+    if (frame.pool == VK_NULL_HANDLE) {
+        VkCommandPoolCreateInfo pool_info{};
+        pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        pool_info.queueFamilyIndex =
+            vkb_device.get_queue_index(vkb::QueueType::graphics).value();
+
+        if (vkCreateCommandPool(vkb_device.device, &pool_info,
+                                vkb_device.allocation_callbacks,
+                                &frame.pool) != VK_SUCCESS) {
+            println("Could not create recording command pool");
+            frame.pool = VK_NULL_HANDLE;
+            return {};
+        }
+    }
+
+    if (frame.used == frame.buffers.size()) {
+        VkCommandBufferAllocateInfo alloc_info{};
+        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.commandPool = frame.pool;
+        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        alloc_info.commandBufferCount = 1;
+
+        VkCommandBuffer cmd;
+        if (vkAllocateCommandBuffers(vkb_device.device, &alloc_info, &cmd) !=
+            VK_SUCCESS) {
+            println("Could not allocate secondary command buffer");
+            return {};
+        }
+
+        frame.buffers.push_back(cmd);
+    }
+
+    return frame.buffers[frame.used++];
+}
+
+void CommandRecorder::ResetFrame() {
+    std::lock_guard lock{mutex};
+
+    for (auto& [id, thread_pools] : threads) {
+        if (vk_frame_index >= thread_pools->frames.size()) {
+            continue;
+        }
+
+        auto& frame = thread_pools->frames[vk_frame_index];
+        if (frame.pool == VK_NULL_HANDLE || frame.used == 0) {
+            continue;
+        }
+
+        vkResetCommandPool(vkb_device.device, frame.pool, 0);
+        frame.used = 0;
+    }
+}
+
+bool CommandRecorder::Record(VkCommandBuffer primary,
+                             const VkCommandBufferInheritanceInfo& inheritance,
+                             size_t count, const RecordFunction& record,
+                             size_t min_chunk_size) {
+    if (count == 0) {
+        return true;
+    }
+
+    // Fixed for a given count and machine, so the chunk boundaries do not
+    // change from frame to frame
+    size_t max_chunks = (thread_pool.GetThreadCount() + 1) * 2;
+    size_t chunk_count =
+        std::clamp(count / std::max(min_chunk_size, size_t(1)), size_t(1),
+                   max_chunks);
+    size_t chunk_size = (count + chunk_count - 1) / chunk_count;
+
+    std::vector<VkCommandBuffer> secondaries(chunk_count, VK_NULL_HANDLE);
+
+    auto record_chunk = [&](size_t chunk) {
+        auto cmd = AllocateSecondary();
+        if (!cmd) {
+            return;
+        }
+
+        VkCommandBufferBeginInfo begin_info{};
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+                           VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        begin_info.pInheritanceInfo = &inheritance;
+
+        vkBeginCommandBuffer(cmd.value(), &begin_info);
+
+        auto begin = chunk * chunk_size;
+        auto end = std::min(begin + chunk_size, count);
+        record(cmd.value(), begin, end);
+
+        vkEndCommandBuffer(cmd.value());
+
+        secondaries[chunk] = cmd.value();
+    };
+
+    auto queue = std::make_shared<ChunkQueue>();
+
+    // Chunks are claimed by whoever is free, so the main thread only ever
+    // waits on chunks that are already being recorded. A helper that starts
+    // late finds nothing left and never touches this frame
+    auto record_chunks = [queue, chunk_count, &record_chunk]() {
+        for (auto chunk = queue->next++; chunk < chunk_count;
+             chunk = queue->next++) {
+            record_chunk(chunk);
+
+            std::lock_guard lock{queue->mutex};
+            if (++queue->done == chunk_count) {
+                queue->finished.notify_one();
+            }
+        }
+    };
+
+    for (size_t helper = 1; helper < chunk_count; helper++) {
+        thread_pool.Enqueue(record_chunks);
+    }
+
+    record_chunks();
+
+    {
+        std::unique_lock lock{queue->mutex};
+        queue->finished.wait(lock,
+                             [&]() { return queue->done == chunk_count; });
+    }
+
+    if (std::ranges::count(secondaries, VK_NULL_HANDLE) != 0) {
+        return false;
+    }
+
+    vkCmdExecuteCommands(primary, uint32_t(secondaries.size()),
+                         secondaries.data());
+
+    return true;
+}
+
+void CommandRecorder::Destroy() {
+    std::lock_guard lock{mutex};
+
+    for (auto& [id, thread_pools] : threads) {
+        for (auto& frame : thread_pools->frames) {
+            if (frame.pool != VK_NULL_HANDLE) {
+                vkDestroyCommandPool(vkb_device.device, frame.pool,
+                                     vkb_device.allocation_callbacks);
+            }
+        }
+    }
+
+    threads.clear();
+}
+
+} // namespace crow
\ No newline at end of file
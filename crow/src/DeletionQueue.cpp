@@ -0,0 +1,143 @@
+#include <Crow/DeletionQueue.hpp>
+
+#include <Crow/Timeline.hpp>
+
+#include <algorithm>
+#include <utility>
+
+namespace crow {
+
+bool DeletionQueue::IsFinished(const Deletion& deletion) {
+    if (vk_timeline_semaphores) {
+        // Compute is not submitted every frame. A stamp the queue has not
+        // reached yet only needs what was actually submitted to finish
+        auto passed = [](const QueueTimeline& timeline, uint64_t value) {
+            return timeline.IsComplete(
+                std::min(value, timeline.GetLastSubmitted()));
+        };
+
+        return passed(graphics_timeline, deletion.graphics_value) &&
+               passed(compute_timeline, deletion.compute_value);
+    }
+
+    // Every frame at least vk_frames_in_flight behind the current one has
+    // finished
+    return deletion.frame + vk_frames_in_flight <= vk_frame_count;
+}
+
+void DeletionQueue::Push(std::function<void()> destroy) {
+    Deletion deletion{vk_frame_count, 0, 0, std::move(destroy)};
+
+    // Work recorded before the release is submitted no earlier than the
+    // next values
+    if (vk_timeline_semaphores) {
+        deletion.graphics_value = graphics_timeline.GetLastSubmitted() + 1;
+        deletion.compute_value = compute_timeline.GetLastSubmitted() + 1;
+    }
+
+    std::lock_guard lock{mutex};
+    deletions.push_back(std::move(deletion));
+}
+
+void DeletionQueue::Push(VkBuffer buffer) {
+    Push([buffer]() {
+        vkDestroyBuffer(vkb_device.device, buffer,
+                        vkb_device.allocation_callbacks);
+    });
+}
+
+void DeletionQueue::Push(VkImage image) {
+    Push([image]() {
+        vkDestroyImage(vkb_device.device, image,
+                       vkb_device.allocation_callbacks);
+    });
+}
+
+void DeletionQueue::Push(VkImageView image_view) {
+    Push([image_view]() {
+        vkDestroyImageView(vkb_device.device, image_view,
+                           vkb_device.allocation_callbacks);
+    });
+}
+
+void DeletionQueue::Push(VkSampler sampler) {
+    Push([sampler]() {
+        vkDestroySampler(vkb_device.device, sampler,
+                         vkb_device.allocation_callbacks);
+    });
+}
+
+void DeletionQueue::Push(VkFramebuffer framebuffer) {
+    Push([framebuffer]() {
+        vkDestroyFramebuffer(vkb_device.device, framebuffer,
+                             vkb_device.allocation_callbacks);
+    });
+}
+
+void DeletionQueue::Push(VkRenderPass render_pass) {
+    Push([render_pass]() {
+        vkDestroyRenderPass(vkb_device.device, render_pass,
+                            vkb_device.allocation_callbacks);
+    });
+}
+
+void DeletionQueue::Push(VkPipeline pipeline) {
+    Push([pipeline]() {
+        vkDestroyPipeline(vkb_device.device, pipeline,
+                          vkb_device.allocation_callbacks);
+    });
+}
+
+void DeletionQueue::Push(VkShaderModule module) {
+    Push([module]() {
+        vkDestroyShaderModule(vkb_device.device, module,
+                              vkb_device.allocation_callbacks);
+    });
+}
+
+void DeletionQueue::Push(VkDescriptorPool descriptor_pool) {
+    Push([descriptor_pool]() {
+        vkDestroyDescriptorPool(vkb_device.device, descriptor_pool,
+                                vkb_device.allocation_callbacks);
+    });
+}
+
+void DeletionQueue::Push(VkSemaphore semaphore) {
+    Push([semaphore]() {
+        vkDestroySemaphore(vkb_device.device, semaphore,
+                           vkb_device.allocation_callbacks);
+    });
+}
+
+void DeletionQueue::Flush() {
+    std::deque<Deletion> ready;
+
+    {
+        std::lock_guard lock{mutex};
+
+        while (!deletions.empty() && IsFinished(deletions.front())) {
+            ready.push_back(std::move(deletions.front()));
+            deletions.pop_front();
+        }
+    }
+
+    // Outside the lock so that a destroy may push more deletions
+    for (auto& deletion : ready) {
+        deletion.destroy();
+    }
+}
+
+void DeletionQueue::Destroy() {
+    std::deque<Deletion> all;
+
+    {
+        std::lock_guard lock{mutex};
+        all.swap(deletions);
+    }
+
+    for (auto& deletion : all) {
+        deletion.destroy();
+    }
+}
+
+} // namespace crow
\ No newline at end of file
@@ -0,0 +1,815 @@
+#include <Crow/Pipeline.hpp>
+
+#include <Crow/DeletionQueue.hpp>
+#include <Crow/Hash.hpp>
+#include <Crow/Log.hpp>
+#include <Crow/PipelineCache.hpp>
+#include <Crow/ThreadPool.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <span>
+
+namespace crow {
+
+namespace {
+
+template <typename T>
+void AppendKey(std::vector<std::byte>& key, const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+
+    auto offset = key.size();
+    key.resize(offset + sizeof(T));
+    std::memcpy(key.data() + offset, &value, sizeof(T));
+}
+
+template <typename T>
+void AppendKey(std::vector<std::byte>& key, const std::vector<T>& values) {
+    static_assert(std::is_trivially_copyable_v<T>);
+
+    AppendKey(key, values.size());
+
+    auto offset = key.size();
+    key.resize(offset + values.size() * sizeof(T));
+    std::memcpy(key.data() + offset, values.data(), values.size() * sizeof(T));
+}
+
+constexpr PipelineLibraryPart pipeline_library_parts[] = {
+    PipelineLibraryPart::VertexInput, PipelineLibraryPart::PreRasterization,
+    PipelineLibraryPart::FragmentShader, PipelineLibraryPart::FragmentOutput};
+
+// All the create infos of a graphics pipeline, pointing into the state
+struct PipelineCreateInfos {
+    std::vector<VkPipelineShaderStageCreateInfo> stages;
+    VkPipelineVertexInputStateCreateInfo vertex_input{};
+    VkPipelineInputAssemblyStateCreateInfo input_assembly{};
+    VkPipelineViewportStateCreateInfo viewport{};
+    VkPipelineRasterizationStateCreateInfo rasterization{};
+    VkPipelineMultisampleStateCreateInfo multisample{};
+    VkPipelineDepthStencilStateCreateInfo depth_stencil{};
+    VkPipelineColorBlendStateCreateInfo color_blend{};
+    VkDynamicState dynamic_states[2] = {VK_DYNAMIC_STATE_VIEWPORT,
+                                        VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamic{};
+    // Describes the attachments when there is no render pass
+    VkPipelineRenderingCreateInfo rendering{};
+
+    explicit PipelineCreateInfos(GraphicsPipelineState& state) {
+        for (auto& stage : state.stages) {
+            stages.push_back(stage.GetCreateInfo());
+        }
+
+        vertex_input.sType =
+            VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        vertex_input.vertexBindingDescriptionCount =
+            uint32_t(state.vertex_bindings.size());
+        vertex_input.pVertexBindingDescriptions = state.vertex_bindings.data();
+        vertex_input.vertexAttributeDescriptionCount =
+            uint32_t(state.vertex_attributes.size());
+        vertex_input.pVertexAttributeDescriptions =
+            state.vertex_attributes.data();
+
+        input_assembly.sType =
+            VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+        input_assembly.topology = state.topology;
+
+        viewport.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+        viewport.viewportCount = 1;
+        viewport.scissorCount = 1;
+
+        rasterization.sType =
+            VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+        rasterization.polygonMode = state.polygon_mode;
+        rasterization.cullMode = state.cull_mode;
+        rasterization.frontFace = state.front_face;
+        rasterization.lineWidth = 1.0f;
+
+        multisample.sType =
+            VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+        multisample.rasterizationSamples = state.samples;
+
+        depth_stencil.sType =
+            VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+        depth_stencil.depthTestEnable = state.depth_test;
+        depth_stencil.depthWriteEnable = state.depth_write;
+        depth_stencil.depthCompareOp = state.depth_compare;
+
+        color_blend.sType =
+            VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+        color_blend.attachmentCount = uint32_t(state.blend_attachments.size());
+        color_blend.pAttachments = state.blend_attachments.data();
+
+        dynamic.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dynamic.dynamicStateCount = 2;
+        dynamic.pDynamicStates = dynamic_states;
+
+        rendering.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+        rendering.colorAttachmentCount = uint32_t(state.color_formats.size());
+        rendering.pColorAttachmentFormats = state.color_formats.data();
+        rendering.depthAttachmentFormat = state.depth_format;
+    }
+
+    // Chained into the create info of pipelines for dynamic rendering
+    inline const void* GetRenderingInfo(const GraphicsPipelineState& state) {
+        if (state.render_pass != VK_NULL_HANDLE) {
+            return nullptr;
+        }
+
+        return &rendering;
+    }
+
+    PipelineCreateInfos(const PipelineCreateInfos&) = delete;
+    PipelineCreateInfos& operator=(const PipelineCreateInfos&) = delete;
+};
+
+std::optional<VkPipeline> CreatePart(PipelineLibraryPart part,
+                                     GraphicsPipelineState& state,
+                                     VkPipelineCache cache) {
+    PipelineCreateInfos infos{state};
+
+    VkGraphicsPipelineLibraryCreateInfoEXT library_info{};
+    library_info.sType =
+        VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+
+    VkGraphicsPipelineCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    create_info.pNext = &library_info;
+    create_info.flags =
+        VK_PIPELINE_CREATE_LIBRARY_BIT_KHR |
+        VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+
+    std::vector<VkPipelineShaderStageCreateInfo> stages;
+
+    switch (part) {
+    case PipelineLibraryPart::VertexInput:
+        library_info.flags =
+            VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT;
+        create_info.pVertexInputState = &infos.vertex_input;
+        create_info.pInputAssemblyState = &infos.input_assembly;
+        break;
+
+    case PipelineLibraryPart::PreRasterization:
+        library_info.pNext = infos.GetRenderingInfo(state);
+        library_info.flags =
+            VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT;
+        for (auto& stage : infos.stages) {
+            if (stage.stage != VK_SHADER_STAGE_FRAGMENT_BIT) {
+                stages.push_back(stage);
+            }
+        }
+        create_info.pViewportState = &infos.viewport;
+        create_info.pRasterizationState = &infos.rasterization;
+        create_info.pDynamicState = &infos.dynamic;
+        create_info.layout = state.layout;
+        create_info.renderPass = state.render_pass;
+        create_info.subpass = state.subpass;
+        break;
+
+    case PipelineLibraryPart::FragmentShader:
+        library_info.pNext = infos.GetRenderingInfo(state);
+        library_info.flags =
+            VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT;
+        for (auto& stage : infos.stages) {
+            if (stage.stage == VK_SHADER_STAGE_FRAGMENT_BIT) {
+                stages.push_back(stage);
+            }
+        }
+        create_info.pMultisampleState = &infos.multisample;
+        create_info.pDepthStencilState = &infos.depth_stencil;
+        create_info.layout = state.layout;
+        create_info.renderPass = state.render_pass;
+        create_info.subpass = state.subpass;
+        break;
+
+    case PipelineLibraryPart::FragmentOutput:
+        library_info.pNext = infos.GetRenderingInfo(state);
+        library_info.flags =
+            VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT;
+        create_info.pMultisampleState = &infos.multisample;
+        create_info.pColorBlendState = &infos.color_blend;
+        create_info.renderPass = state.render_pass;
+        create_info.subpass = state.subpass;
+        break;
+    }
+
+    create_info.stageCount = uint32_t(stages.size());
+    create_info.pStages = stages.data();
+
+    VkPipeline pipeline;
+    if (vkCreateGraphicsPipelines(vkb_device.device, cache, 1, &create_info,
+                                  vkb_device.allocation_callbacks,
+                                  &pipeline) != VK_SUCCESS) {
+        println("Could not create graphics pipeline library part {}",
+                int(part));
+        return {};
+    }
+
+    return pipeline;
+}
+
+std::optional<VkPipeline> CreateMonolithic(GraphicsPipelineState& state,
+                                           VkPipelineCache cache) {
+    PipelineCreateInfos infos{state};
+
+    VkGraphicsPipelineCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    create_info.pNext = infos.GetRenderingInfo(state);
+    create_info.stageCount = uint32_t(infos.stages.size());
+    create_info.pStages = infos.stages.data();
+    create_info.pVertexInputState = &infos.vertex_input;
+    create_info.pInputAssemblyState = &infos.input_assembly;
+    create_info.pViewportState = &infos.viewport;
+    create_info.pRasterizationState = &infos.rasterization;
+    create_info.pMultisampleState = &infos.multisample;
+    create_info.pDepthStencilState = &infos.depth_stencil;
+    create_info.pColorBlendState = &infos.color_blend;
+    create_info.pDynamicState = &infos.dynamic;
+    create_info.layout = state.layout;
+    create_info.renderPass = state.render_pass;
+    create_info.subpass = state.subpass;
+
+    VkPipeline pipeline;
+    if (vkCreateGraphicsPipelines(vkb_device.device, cache, 1, &create_info,
+                                  vkb_device.allocation_callbacks,
+                                  &pipeline) != VK_SUCCESS) {
+        println("Could not create graphics pipeline");
+        return {};
+    }
+
+    return pipeline;
+}
+
+uint64_t GetNanosecondsSince(std::chrono::steady_clock::time_point start) {
+    return uint64_t(std::chrono::nanoseconds(
+                        std::chrono::steady_clock::now() - start)
+                        .count());
+}
+
+// One in this many linked pipelines is also created in full
+constexpr uint64_t full_creation_sample_rate = 8;
+
+double ToMilliseconds(uint64_t nanoseconds) {
+    return double(nanoseconds) / 1000000.0;
+}
+
+} // namespace
+
+std::vector<std::byte>
+GraphicsPipelineState::GetPartKey(PipelineLibraryPart part) const {
+    std::vector<std::byte> key;
+    key.reserve(128);
+
+    AppendKey(key, part);
+
+    if (part == PipelineLibraryPart::VertexInput) {
+        AppendKey(key, vertex_bindings);
+        AppendKey(key, vertex_attributes);
+        AppendKey(key, topology);
+        return key;
+    }
+
+    if (part != PipelineLibraryPart::FragmentOutput) {
+        bool fragment = part == PipelineLibraryPart::FragmentShader;
+
+        for (auto& stage : stages) {
+            if ((stage.stage == VK_SHADER_STAGE_FRAGMENT_BIT) != fragment) {
+                continue;
+            }
+
+            AppendKey(key, stage.stage);
+            AppendKey(key, stage.hash);
+            // Stages made without a hash can only be told apart by handle
+            if (stage.hash == 0) {
+                AppendKey(key, stage.module);
+            }
+            AppendKey(key, HashString(stage.entry_point));
+            AppendKey(key, stage.specialization.GetHash());
+        }
+
+        AppendKey(key, layout);
+    }
+
+    if (part == PipelineLibraryPart::PreRasterization) {
+        AppendKey(key, polygon_mode);
+        AppendKey(key, cull_mode);
+        AppendKey(key, front_face);
+    } else if (part == PipelineLibraryPart::FragmentShader) {
+        AppendKey(key, depth_test);
+        AppendKey(key, depth_write);
+        AppendKey(key, depth_compare);
+    } else {
+        AppendKey(key, blend_attachments);
+    }
+
+    // Render pass compatibility, pipelines for dynamic rendering cannot be
+    // used in a render pass
+    AppendKey(key, render_pass == VK_NULL_HANDLE);
+    AppendKey(key, color_formats);
+    AppendKey(key, depth_format);
+    AppendKey(key, samples);
+    AppendKey(key, subpass);
+
+    return key;
+}
+
+std::vector<std::byte> GraphicsPipelineState::GetKey() const {
+    std::vector<std::byte> key;
+
+    for (auto part : pipeline_library_parts) {
+        auto part_key = GetPartKey(part);
+        key.insert(key.end(), part_key.begin(), part_key.end());
+    }
+
+    return key;
+}
+
+GraphicsPipelineBuilder&
+GraphicsPipelineBuilder::AddColorAttachment(VkFormat format) {
+    VkPipelineColorBlendAttachmentState blend{};
+    blend.blendEnable = VK_FALSE;
+    blend.colorWriteMask =
+        VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+        VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    state.blend_attachments.push_back(blend);
+    state.color_formats.push_back(format);
+
+    return *this;
+}
+
+GraphicsPipelineBuilder&
+GraphicsPipelineBuilder::AddBlendedColorAttachment(VkFormat format) {
+    VkPipelineColorBlendAttachmentState blend{};
+    blend.blendEnable = VK_TRUE;
+    blend.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    blend.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blend.colorBlendOp = VK_BLEND_OP_ADD;
+    blend.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    blend.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blend.alphaBlendOp = VK_BLEND_OP_ADD;
+    blend.colorWriteMask =
+        VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+        VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    state.blend_attachments.push_back(blend);
+    state.color_formats.push_back(format);
+
+    return *this;
+}
+
+std::optional<VkPipeline> CreateGraphicsPipeline(GraphicsPipelineState& state,
+                                                 VkPipelineCache cache) {
+    auto start = std::chrono::steady_clock::now();
+
+    auto pipeline = CreateMonolithic(state, cache);
+    if (pipeline) {
+        pipeline_cache.AddCreationTime(std::chrono::steady_clock::now() -
+                                       start);
+    }
+
+    return pipeline;
+}
+
+std::optional<VkPipeline>
+PipelineLibraryCache::FindPart(PipelineLibraryPart part,
+                               const GraphicsPipelineState& state) {
+    auto key = state.GetPartKey(part);
+    auto hash = HashSpan(std::span<const std::byte>(key));
+
+    std::lock_guard lock{mutex};
+
+    auto [begin, end] = parts.equal_range(hash);
+    for (auto it = begin; it != end; it++) {
+        if (it->second.key == key) {
+            return it->second.pipeline;
+        }
+    }
+
+    return {};
+}
+
+std::optional<VkPipeline>
+PipelineLibraryCache::GetPart(PipelineLibraryPart part,
+                              GraphicsPipelineState& state,
+                              VkPipelineCache cache) {
+    auto existing = FindPart(part, state);
+    if (existing) {
+        return existing;
+    }
+
+    // Created without the lock, so two threads may race to create the same
+    // part. The loser destroys its copy
+    auto start = std::chrono::steady_clock::now();
+
+    auto pipeline = CreatePart(part, state, cache);
+    if (!pipeline) {
+        return {};
+    }
+
+    part_time += GetNanosecondsSince(start);
+
+    auto key = state.GetPartKey(part);
+    auto hash = HashSpan(std::span<const std::byte>(key));
+
+    std::lock_guard lock{mutex};
+
+    auto [begin, end] = parts.equal_range(hash);
+    for (auto it = begin; it != end; it++) {
+        if (it->second.key == key) {
+            vkDestroyPipeline(vkb_device.device, pipeline.value(),
+                              vkb_device.allocation_callbacks);
+            return it->second.pipeline;
+        }
+    }
+
+    parts.emplace(hash, Part{std::move(key), pipeline.value()});
+
+    return pipeline;
+}
+
+bool PipelineLibraryCache::HasParts(const GraphicsPipelineState& state) {
+    for (auto part : pipeline_library_parts) {
+        if (!FindPart(part, state)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+std::optional<VkPipeline>
+PipelineLibraryCache::Link(GraphicsPipelineState& state, bool optimize,
+                           VkPipelineCache cache) {
+    std::vector<VkPipeline> libraries;
+
+    for (auto part : pipeline_library_parts) {
+        auto library = GetPart(part, state, cache);
+        if (!library) {
+            return {};
+        }
+
+        libraries.push_back(library.value());
+    }
+
+    VkPipelineLibraryCreateInfoKHR library_info{};
+    library_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+    library_info.libraryCount = uint32_t(libraries.size());
+    library_info.pLibraries = libraries.data();
+
+    VkGraphicsPipelineCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    create_info.pNext = &library_info;
+    create_info.layout = state.layout;
+
+    if (optimize) {
+        create_info.flags = VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    VkPipeline pipeline;
+    if (vkCreateGraphicsPipelines(vkb_device.device, cache, 1, &create_info,
+                                  vkb_device.allocation_callbacks,
+                                  &pipeline) != VK_SUCCESS) {
+        println("Could not link graphics pipeline");
+        return {};
+    }
+
+    auto time = GetNanosecondsSince(start);
+
+    if (optimize) {
+        optimized_links++;
+        optimized_link_time += time;
+    } else {
+        fast_links++;
+        fast_link_time += time;
+    }
+
+    return pipeline;
+}
+
+void PipelineLibraryCache::SampleFullCreation(
+    [[maybe_unused]] GraphicsPipelineState& state) {
+#ifdef CROW_DEBUG
+    if (samples++ % full_creation_sample_rate != 0) {
+        return;
+    }
+
+    // Without a pipeline cache, since that is what the parts stand in for
+    auto start = std::chrono::steady_clock::now();
+
+    auto pipeline = CreateMonolithic(state, VK_NULL_HANDLE);
+    if (!pipeline) {
+        return;
+    }
+
+    full_creation_time += GetNanosecondsSince(start);
+    full_creations++;
+
+    vkDestroyPipeline(vkb_device.device, pipeline.value(),
+                      vkb_device.allocation_callbacks);
+#endif
+}
+
+PipelineLibraryStats PipelineLibraryCache::GetStats() {
+    PipelineLibraryStats stats{};
+
+    {
+        std::lock_guard lock{mutex};
+        stats.parts = parts.size();
+    }
+
+    stats.fast_links = fast_links;
+    stats.optimized_links = optimized_links;
+    stats.part_time = part_time;
+    stats.fast_link_time = fast_link_time;
+    stats.optimized_link_time = optimized_link_time;
+    stats.full_creations = full_creations;
+    stats.full_creation_time = full_creation_time;
+
+    return stats;
+}
+
+void PipelineLibraryCache::Destroy() {
+    auto stats = GetStats();
+
+    if (stats.fast_links != 0 && stats.optimized_links != 0) {
+        auto fast = ToMilliseconds(stats.fast_link_time) / stats.fast_links;
+        auto optimized = ToMilliseconds(stats.optimized_link_time) /
+                         stats.optimized_links;
+
+        println("Pipeline library: {} parts, fast links took {:.3f} ms and "
+                "optimized links {:.3f} ms on average",
+                stats.parts, fast, optimized);
+    }
+
+    // Every fast linked pipeline would otherwise have been a full creation,
+    // while the parts and the fast links are what it cost instead. The
+    // optimized links run in the background once the pipeline is usable
+    if (stats.fast_links != 0 && stats.full_creations != 0) {
+        auto linked = ToMilliseconds(stats.part_time + stats.fast_link_time);
+        auto full = ToMilliseconds(stats.full_creation_time) /
+                    double(stats.full_creations) * double(stats.fast_links);
+
+        println("Pipeline library: {} pipelines took {:.2f} ms to link "
+                "against about {:.2f} ms to create in full, {:.2f} ms saved",
+                stats.fast_links, linked, full, full - linked);
+    }
+
+    std::lock_guard lock{mutex};
+
+    for (auto& [hash, part] : parts) {
+        vkDestroyPipeline(vkb_device.device, part.pipeline,
+                          vkb_device.allocation_callbacks);
+    }
+
+    parts.clear();
+}
+
+std::shared_ptr<PipelineManager::Entry>
+PipelineManager::FindOrQueue(const GraphicsPipelineState& state) {
+    auto key = state.GetKey();
+    auto hash = HashSpan(std::span<const std::byte>(key));
+
+    std::shared_ptr<Entry> entry;
+    std::shared_ptr<std::packaged_task<void()>> task;
+
+    {
+        std::lock_guard lock{mutex};
+
+        auto [begin, end] = pipelines.equal_range(hash);
+        for (auto it = begin; it != end; it++) {
+            if (it->second->key == key) {
+                return it->second;
+            }
+        }
+
+        // The task keeps the entry alive in case it is invalidated meanwhile.
+        // It is only queued after the quick link below, which it would repeat
+        entry = std::make_shared<Entry>();
+        task = std::make_shared<std::packaged_task<void()>>(
+            [entry]() { Compile(*entry); });
+
+        entry->key = std::move(key);
+        entry->state = state;
+        entry->compiled = task->get_future().share();
+
+        pipelines.emplace(hash, entry);
+    }
+
+    // Linking cached parts is quick enough to do right here, only the
+    // optimized link goes to the thread pool. Other threads see the entry as
+    // pending until then instead of waiting on the lock
+    if (vk_graphics_pipeline_library &&
+        pipeline_library_cache.HasParts(entry->state)) {
+        auto pipeline = pipeline_library_cache.Link(entry->state, false,
+                                                    pipeline_cache.Get());
+        if (pipeline) {
+            entry->fast_pipeline = pipeline.value();
+            entry->pipeline = pipeline.value();
+            entry->status = Status::Ready;
+        }
+    }
+
+    thread_pool.Enqueue([task]() { (*task)(); });
+
+    return entry;
+}
+
+void PipelineManager::Compile(Entry& entry) {
+    auto cache = pipeline_cache.AcquireWorkerCache();
+
+    if (vk_graphics_pipeline_library) {
+        if (entry.status != Status::Ready) {
+            auto fast = pipeline_library_cache.Link(entry.state, false, cache);
+            if (fast) {
+                entry.fast_pipeline = fast.value();
+                entry.pipeline = fast.value();
+                entry.status = Status::Ready;
+            }
+        }
+
+        if (entry.status == Status::Ready) {
+            auto optimized =
+                pipeline_library_cache.Link(entry.state, true, cache);
+            if (optimized) {
+                entry.pipeline = optimized.value();
+            }
+
+            pipeline_library_cache.SampleFullCreation(entry.state);
+
+            pipeline_cache.ReleaseWorkerCache(cache);
+            return;
+        }
+    }
+
+    auto pipeline = CreateGraphicsPipeline(entry.state, cache);
+
+    pipeline_cache.ReleaseWorkerCache(cache);
+
+    if (!pipeline) {
+        entry.status = Status::Failed;
+        return;
+    }
+
+    entry.pipeline = pipeline.value();
+    entry.status = Status::Ready;
+}
+
+std::optional<VkPipeline>
+PipelineManager::GetPipeline(const GraphicsPipelineState& state,
+                             PipelineMissBehavior behavior) {
+    auto entry = FindOrQueue(state);
+
+    if (entry->status == Status::Pending) {
+        switch (behavior) {
+        case PipelineMissBehavior::Skip:
+            return {};
+
+        case PipelineMissBehavior::Fallback: {
+            std::lock_guard lock{mutex};
+            if (fallback == VK_NULL_HANDLE) {
+                return {};
+            }
+            return fallback;
+        }
+
+        case PipelineMissBehavior::Wait:
+            entry->compiled.wait();
+            break;
+        }
+    }
+
+    if (entry->status != Status::Ready) {
+        return {};
+    }
+
+    return entry->pipeline;
+}
+
+void PipelineManager::Prepare(const GraphicsPipelineState& state) {
+    FindOrQueue(state);
+}
+
+bool PipelineManager::SetFallback(const GraphicsPipelineState& state) {
+    auto copy = state;
+    auto pipeline = CreateGraphicsPipeline(copy, pipeline_cache.Get());
+    if (!pipeline) {
+        return false;
+    }
+
+    std::lock_guard lock{mutex};
+
+    // Frames in flight may still be drawing with the old one
+    if (fallback != VK_NULL_HANDLE) {
+        deletion_queue.Push(fallback);
+    }
+
+    fallback = pipeline.value();
+    return true;
+}
+
+void PipelineManager::DestroyEntry(Entry& entry) {
+    VkPipeline pipeline = entry.pipeline;
+    if (pipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(vkb_device.device, pipeline,
+                          vkb_device.allocation_callbacks);
+    }
+
+    if (entry.fast_pipeline != VK_NULL_HANDLE &&
+        entry.fast_pipeline != pipeline) {
+        vkDestroyPipeline(vkb_device.device, entry.fast_pipeline,
+                          vkb_device.allocation_callbacks);
+    }
+}
+
+void PipelineManager::Invalidate(uint64_t shader_hash) {
+    std::lock_guard lock{mutex};
+
+    for (auto it = pipelines.begin(); it != pipelines.end();) {
+        auto& stages = it->second->state.stages;
+        bool uses = std::ranges::any_of(stages, [&](const ShaderStage& stage) {
+            return stage.hash == shader_hash;
+        });
+
+        if (uses) {
+            retired.push_back(std::move(it->second));
+            it = pipelines.erase(it);
+        } else {
+            it++;
+        }
+    }
+
+    // Nothing waits on a compile here, entries that are still compiling are
+    // picked up by a later call or by Destroy
+    std::erase_if(retired, [](const std::shared_ptr<Entry>& entry) {
+        if (entry->compiled.wait_for(std::chrono::seconds(0)) !=
+            std::future_status::ready) {
+            return false;
+        }
+
+        // Frames in flight may still be drawing with them
+        VkPipeline pipeline = entry->pipeline;
+        if (pipeline != VK_NULL_HANDLE) {
+            deletion_queue.Push(pipeline);
+        }
+
+        if (entry->fast_pipeline != VK_NULL_HANDLE &&
+            entry->fast_pipeline != pipeline) {
+            deletion_queue.Push(entry->fast_pipeline);
+        }
+
+        return true;
+    });
+}
+
+PipelineManagerStats PipelineManager::GetStats() {
+    std::lock_guard lock{mutex};
+
+    PipelineManagerStats stats{};
+    for (auto& [hash, entry] : pipelines) {
+        switch (entry->status.load()) {
+        case Status::Pending:
+            stats.pending++;
+            break;
+
+        case Status::Ready:
+            stats.pipelines++;
+            break;
+
+        case Status::Failed:
+            stats.failed++;
+            break;
+        }
+    }
+
+    return stats;
+}
+
+void PipelineManager::Destroy() {
+    std::lock_guard lock{mutex};
+
+    for (auto& [hash, entry] : pipelines) {
+        entry->compiled.wait();
+        DestroyEntry(*entry);
+    }
+
+    for (auto& entry : retired) {
+        entry->compiled.wait();
+        DestroyEntry(*entry);
+    }
+
+    pipelines.clear();
+    retired.clear();
+
+    if (fallback != VK_NULL_HANDLE) {
+        vkDestroyPipeline(vkb_device.device, fallback,
+                          vkb_device.allocation_callbacks);
+        fallback = VK_NULL_HANDLE;
+    }
+
+    pipeline_library_cache.Destroy();
+}
+
+} // namespace crow
\ No newline at end of file
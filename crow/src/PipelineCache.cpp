@@ -0,0 +1,264 @@
+#include <Crow/PipelineCache.hpp>
+
+#include <Crow/Log.hpp>
+
+#include <cstring>
+#include <fstream>
+
+namespace crow {
+
+namespace {
+
+constexpr uint32_t cache_magic = 0x43505243; // "CRPC"
+constexpr uint32_t cache_version = 2;
+
+struct FileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t cold_creation_time;
+    uint64_t cold_creation_count;
+    uint64_t data_size;
+};
+
+// Drivers are supposed to reject foreign data themselves, but not all of them
+// do so gracefully
+bool IsCompatible(const std::vector<char>& data) {
+    VkPipelineCacheHeaderVersionOne header;
+    if (data.size() < sizeof(header)) {
+        return false;
+    }
+
+    std::memcpy(&header, data.data(), sizeof(header));
+
+    auto& properties = vkb_device.physical_device.properties;
+
+    return header.headerSize >= sizeof(header) &&
+           header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header.vendorID == properties.vendorID &&
+           header.deviceID == properties.deviceID &&
+           std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID,
+                       VK_UUID_SIZE) == 0;
+}
+
+double ToMilliseconds(uint64_t nanoseconds) {
+    return double(nanoseconds) / 1000000.0;
+}
+
+} // namespace
+
+bool PipelineCache::Load(const std::filesystem::path& path) {
+    this->path = path;
+    warm = false;
+    cold_creation_time = 0;
+    cold_creation_count = 0;
+
+    std::vector<char> data;
+
+    std::ifstream file(path, std::ios::binary);
+    if (file) {
+        FileHeader header{};
+        file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+        std::error_code ec;
+        auto file_size = std::filesystem::file_size(path, ec);
+
+        if (file && !ec && header.magic == cache_magic &&
+            header.version == cache_version &&
+            header.data_size <= file_size - sizeof(header)) {
+            data.resize(header.data_size);
+            file.read(data.data(), std::streamsize(data.size()));
+
+            if (!file) {
+                data.clear();
+            }
+
+            cold_creation_time = header.cold_creation_time;
+            cold_creation_count = header.cold_creation_count;
+        }
+
+        if (!data.empty() && !IsCompatible(data)) {
+            println("Pipeline cache {} was written by a different device or "
+                    "driver, starting empty",
+                    path.string());
+            data.clear();
+        }
+    }
+
+    VkPipelineCacheCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    create_info.initialDataSize = data.size();
+    create_info.pInitialData = data.empty() ? nullptr : data.data();
+
+    auto result = vkCreatePipelineCache(vkb_device.device, &create_info,
+                                        vkb_device.allocation_callbacks,
+                                        &cache);
+
+    // Retry without the data in case the driver still did not like it
+    if (result != VK_SUCCESS && !data.empty()) {
+        data.clear();
+        create_info.initialDataSize = 0;
+        create_info.pInitialData = nullptr;
+
+        result = vkCreatePipelineCache(vkb_device.device, &create_info,
+                                       vkb_device.allocation_callbacks,
+                                       &cache);
+    }
+
+    if (result != VK_SUCCESS) {
+        println("Could not create pipeline cache");
+        cache = VK_NULL_HANDLE;
+        return false;
+    }
+
+    // The driver always writes at least a header, so data alone does not
+    // mean any pipeline was cached. Without a baseline this session is the
+    // cold one, which also covers a cache that was thrown away above
+    warm = !data.empty() && cold_creation_count != 0;
+    if (!warm) {
+        cold_creation_time = 0;
+        cold_creation_count = 0;
+    }
+
+    println("Loaded pipeline cache {} ({} bytes)", path.string(),
+            data.size());
+
+    return true;
+}
+
+bool PipelineCache::Save() {
+    if (cache == VK_NULL_HANDLE || path.empty()) {
+        return false;
+    }
+
+    MergeWorkerCaches();
+
+    auto time = creation_time.load();
+    auto count = creation_count.load();
+
+    if (!warm) {
+        println("Created {} pipelines in {:.2f} ms without the pipeline cache",
+                count, ToMilliseconds(time));
+    } else if (count != 0) {
+        auto average = ToMilliseconds(time) / double(count);
+        auto cold_average =
+            ToMilliseconds(cold_creation_time) / double(cold_creation_count);
+
+        println("Created {} pipelines in {:.2f} ms, {:.3f} ms each against "
+                "{:.3f} ms without the pipeline cache",
+                count, ToMilliseconds(time), average, cold_average);
+    }
+
+    size_t size = 0;
+    if (vkGetPipelineCacheData(vkb_device.device, cache, &size, nullptr) !=
+        VK_SUCCESS) {
+        println("Could not get pipeline cache data");
+        return false;
+    }
+
+    std::vector<char> data(size);
+    if (vkGetPipelineCacheData(vkb_device.device, cache, &size,
+                               data.data()) != VK_SUCCESS) {
+        println("Could not get pipeline cache data");
+        return false;
+    }
+    data.resize(size);
+
+    std::error_code ec;
+    if (path.has_parent_path()) {
+        std::filesystem::create_directories(path.parent_path(), ec);
+    }
+
+    auto temp_path = path;
+    temp_path += ".tmp";
+
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            println("Could not write pipeline cache {}", path.string());
+            return false;
+        }
+
+        // Keep the baseline from the last cold run so every warm run can be
+        // compared against it
+        FileHeader header{};
+        header.magic = cache_magic;
+        header.version = cache_version;
+        header.cold_creation_time = warm ? cold_creation_time : time;
+        header.cold_creation_count = warm ? cold_creation_count : count;
+        header.data_size = data.size();
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(data.data(), std::streamsize(data.size()));
+    }
+
+    std::filesystem::rename(temp_path, path, ec);
+    if (ec) {
+        println("Could not write pipeline cache {}: {}", path.string(),
+                ec.message());
+        std::filesystem::remove(temp_path, ec);
+        return false;
+    }
+
+    return true;
+}
+
+void PipelineCache::Destroy() {
+    MergeWorkerCaches();
+
+    if (cache != VK_NULL_HANDLE) {
+        vkDestroyPipelineCache(vkb_device.device, cache,
+                               vkb_device.allocation_callbacks);
+        cache = VK_NULL_HANDLE;
+    }
+}
+
+VkPipelineCache PipelineCache::AcquireWorkerCache() {
+    VkPipelineCacheCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+    VkPipelineCache worker_cache;
+    if (vkCreatePipelineCache(vkb_device.device, &create_info,
+                              vkb_device.allocation_callbacks,
+                              &worker_cache) != VK_SUCCESS) {
+        // The main cache is internally synchronized, so it still works
+        return cache;
+    }
+
+    return worker_cache;
+}
+
+void PipelineCache::ReleaseWorkerCache(VkPipelineCache worker_cache) {
+    if (worker_cache == VK_NULL_HANDLE || worker_cache == cache) {
+        return;
+    }
+
+    std::lock_guard lock{mutex};
+    worker_caches.push_back(worker_cache);
+}
+
+void PipelineCache::MergeWorkerCaches() {
+    std::vector<VkPipelineCache> caches;
+
+    {
+        std::lock_guard lock{mutex};
+        caches.swap(worker_caches);
+    }
+
+    if (caches.empty()) {
+        return;
+    }
+
+    if (cache != VK_NULL_HANDLE &&
+        vkMergePipelineCaches(vkb_device.device, cache,
+                              uint32_t(caches.size()),
+                              caches.data()) != VK_SUCCESS) {
+        println("Could not merge worker pipeline caches");
+    }
+
+    for (auto& worker_cache : caches) {
+        vkDestroyPipelineCache(vkb_device.device, worker_cache,
+                               vkb_device.allocation_callbacks);
+    }
+}
+
+} // namespace crow
\ No newline at end of file
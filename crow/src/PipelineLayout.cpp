@@ -0,0 +1,193 @@
+#include <Crow/PipelineLayout.hpp>
+
+#include <Crow/Hash.hpp>
+#include <Crow/Log.hpp>
+
+#include <algorithm>
+
+namespace crow {
+
+namespace {
+
+uint64_t HashBindings(std::span<const VkDescriptorSetLayoutBinding> bindings) {
+    auto hash = HashValue(bindings.size());
+    for (auto& binding : bindings) {
+        hash = HashValue(binding.binding, hash);
+        hash = HashValue(binding.descriptorType, hash);
+        hash = HashValue(binding.descriptorCount, hash);
+        hash = HashValue(binding.stageFlags, hash);
+    }
+    return hash;
+}
+
+bool BindingsEqual(std::span<const VkDescriptorSetLayoutBinding> a,
+                   std::span<const VkDescriptorSetLayoutBinding> b) {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+                      [](auto& x, auto& y) {
+                          return x.binding == y.binding &&
+                                 x.descriptorType == y.descriptorType &&
+                                 x.descriptorCount == y.descriptorCount &&
+                                 x.stageFlags == y.stageFlags;
+                      });
+}
+
+bool RangesEqual(std::span<const VkPushConstantRange> a,
+                 std::span<const VkPushConstantRange> b) {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+                      [](auto& x, auto& y) {
+                          return x.stageFlags == y.stageFlags &&
+                                 x.offset == y.offset && x.size == y.size;
+                      });
+}
+
+} // namespace
+
+std::optional<VkDescriptorSetLayout>
+PipelineLayoutCache::GetDescriptorSetLayout(
+    std::vector<VkDescriptorSetLayoutBinding> bindings) {
+    std::sort(bindings.begin(), bindings.end(),
+              [](auto& a, auto& b) { return a.binding < b.binding; });
+
+    auto hash = HashBindings(bindings);
+
+    std::lock_guard lock{mutex};
+
+    auto [begin, end] = set_layouts.equal_range(hash);
+    for (auto it = begin; it != end; it++) {
+        if (BindingsEqual(it->second.bindings, bindings)) {
+            return it->second.layout;
+        }
+    }
+
+    VkDescriptorSetLayoutCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    create_info.bindingCount = uint32_t(bindings.size());
+    create_info.pBindings = bindings.data();
+
+    VkDescriptorSetLayout layout;
+    if (vkCreateDescriptorSetLayout(vkb_device.device, &create_info,
+                                    vkb_device.allocation_callbacks,
+                                    &layout) != VK_SUCCESS) {
+        println("Could not create descriptor set layout");
+        return {};
+    }
+
+    set_layouts.emplace(hash, SetLayoutEntry{std::move(bindings), layout});
+
+    return layout;
+}
+
+std::optional<VkPipelineLayout> PipelineLayoutCache::GetPipelineLayout(
+    std::span<const VkDescriptorSetLayout> set_layouts,
+    std::span<const VkPushConstantRange> push_constant_ranges,
+    VkPipelineLayoutCreateFlags flags) {
+    auto hash = HashSpan(set_layouts);
+    hash = HashValue(flags, hash);
+    hash = HashValue(push_constant_ranges.size(), hash);
+    for (auto& range : push_constant_ranges) {
+        hash = HashValue(range.stageFlags, hash);
+        hash = HashValue(range.offset, hash);
+        hash = HashValue(range.size, hash);
+    }
+
+    std::lock_guard lock{mutex};
+
+    auto [begin, end] = pipeline_layouts.equal_range(hash);
+    for (auto it = begin; it != end; it++) {
+        auto& entry = it->second;
+        if (entry.flags == flags &&
+            std::equal(entry.set_layouts.begin(), entry.set_layouts.end(),
+                       set_layouts.begin(), set_layouts.end()) &&
+            RangesEqual(entry.push_constant_ranges, push_constant_ranges)) {
+            return entry.layout;
+        }
+    }
+
+    VkPipelineLayoutCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    create_info.flags = flags;
+    create_info.setLayoutCount = uint32_t(set_layouts.size());
+    create_info.pSetLayouts = set_layouts.data();
+    create_info.pushConstantRangeCount = uint32_t(push_constant_ranges.size());
+    create_info.pPushConstantRanges = push_constant_ranges.data();
+
+    VkPipelineLayout layout;
+    if (vkCreatePipelineLayout(vkb_device.device, &create_info,
+                               vkb_device.allocation_callbacks,
+                               &layout) != VK_SUCCESS) {
+        println("Could not create pipeline layout");
+        return {};
+    }
+
+    PipelineLayoutEntry entry{};
+    entry.set_layouts.assign(set_layouts.begin(), set_layouts.end());
+    entry.push_constant_ranges.assign(push_constant_ranges.begin(),
+                                      push_constant_ranges.end());
+    entry.flags = flags;
+    entry.layout = layout;
+
+    pipeline_layouts.emplace(hash, std::move(entry));
+
+    return layout;
+}
+
+std::optional<PipelineLayoutInfo>
+PipelineLayoutCache::GetPipelineLayout(
+    const PipelineLayoutDescription& description,
+    VkPipelineLayoutCreateFlags flags) {
+    PipelineLayoutInfo info{};
+
+    for (auto& bindings : description.sets) {
+        auto set_layout = GetDescriptorSetLayout(bindings);
+        if (!set_layout) {
+            return {};
+        }
+
+        info.set_layouts.push_back(set_layout.value());
+    }
+
+    auto layout = GetPipelineLayout(info.set_layouts,
+                                    description.push_constant_ranges, flags);
+    if (!layout) {
+        return {};
+    }
+
+    info.layout = layout.value();
+
+    return info;
+}
+
+std::optional<PipelineLayoutInfo>
+PipelineLayoutCache::GetPipelineLayout(std::span<const ShaderReflection> stages,
+                                       VkPipelineLayoutCreateFlags flags) {
+    return GetPipelineLayout(MergeShaderReflections(stages), flags);
+}
+
+size_t PipelineLayoutCache::GetDescriptorSetLayoutCount() {
+    std::lock_guard lock{mutex};
+    return set_layouts.size();
+}
+
+size_t PipelineLayoutCache::GetPipelineLayoutCount() {
+    std::lock_guard lock{mutex};
+    return pipeline_layouts.size();
+}
+
+void PipelineLayoutCache::Destroy() {
+    std::lock_guard lock{mutex};
+
+    for (auto& [hash, entry] : pipeline_layouts) {
+        vkDestroyPipelineLayout(vkb_device.device, entry.layout,
+                                vkb_device.allocation_callbacks);
+    }
+
+    for (auto& [hash, entry] : set_layouts) {
+        vkDestroyDescriptorSetLayout(vkb_device.device, entry.layout,
+                                     vkb_device.allocation_callbacks);
+    }
+
+    pipeline_layouts.clear();
+    set_layouts.clear();
+}
+
+} // namespace crow
\ No newline at end of file
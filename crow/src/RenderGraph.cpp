@@ -0,0 +1,789 @@
+#include <Crow/RenderGraph.hpp>
+
+#include <Crow/DeletionQueue.hpp>
+#include <Crow/Log.hpp>
+
+#include <algorithm>
+#include <numeric>
+#include <optional>
+#include <utility>
+
+namespace crow {
+
+namespace {
+
+struct AccessInfo {
+    VkPipelineStageFlags2 stage;
+    VkAccessFlags2 access;
+    VkImageLayout layout;
+    VkImageUsageFlags usage;
+};
+
+// Only flags that also exist in the original synchronization API, so that
+// barriers can fall back to vkCmdPipelineBarrier
+AccessInfo GetAccessInfo(RenderGraphAccess access) {
+    constexpr VkPipelineStageFlags2 shader_stages =
+        VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT |
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    constexpr VkPipelineStageFlags2 depth_stages =
+        VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT |
+        VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+
+    switch (access) {
+    case RenderGraphAccess::ColorAttachment:
+        return {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT |
+                    VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT};
+    case RenderGraphAccess::DepthAttachment:
+        return {depth_stages,
+                VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                    VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT};
+    case RenderGraphAccess::DepthRead:
+        return {depth_stages | shader_stages,
+                VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                    VK_ACCESS_2_SHADER_READ_BIT,
+                VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+                VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                    VK_IMAGE_USAGE_SAMPLED_BIT};
+    case RenderGraphAccess::Sampled:
+        return {shader_stages, VK_ACCESS_2_SHADER_READ_BIT,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_IMAGE_USAGE_SAMPLED_BIT};
+    case RenderGraphAccess::StorageRead:
+        return {shader_stages, VK_ACCESS_2_SHADER_READ_BIT,
+                VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT};
+    case RenderGraphAccess::StorageWrite:
+        return {shader_stages,
+                VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT,
+                VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT};
+    case RenderGraphAccess::TransferSrc:
+        return {VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT,
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                VK_IMAGE_USAGE_TRANSFER_SRC_BIT};
+    case RenderGraphAccess::TransferDst:
+        return {VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                VK_IMAGE_USAGE_TRANSFER_DST_BIT};
+    }
+
+    return {};
+}
+
+bool IsDepthFormat(VkFormat format) {
+    switch (format) {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_D32_SFLOAT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+VkImageAspectFlags GetAspect(VkFormat format) {
+    switch (format) {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_D32_SFLOAT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT;
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    default:
+        return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
+std::optional<uint32_t> FindMemoryType(uint32_t type_bits) {
+    auto& properties = vkb_device.physical_device.memory_properties;
+
+    for (uint32_t i = 0; i < properties.memoryTypeCount; i++) {
+        if ((type_bits & (1u << i)) &&
+            (properties.memoryTypes[i].propertyFlags &
+             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)) {
+            return i;
+        }
+    }
+
+    return {};
+}
+
+VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Loaded from the device when synchronization2 is enabled
+PFN_vkCmdPipelineBarrier2KHR cmd_pipeline_barrier_2 = nullptr;
+
+} // namespace
+
+RenderGraphPassBuilder& RenderGraphPassBuilder::Read(RenderGraphImage image,
+                                                     RenderGraphAccess access) {
+    graph.passes[pass].uses.push_back({image, access, false});
+    graph.images[image].usage |= GetAccessInfo(access).usage;
+    return *this;
+}
+
+RenderGraphPassBuilder&
+RenderGraphPassBuilder::Write(RenderGraphImage image,
+                              RenderGraphAccess access) {
+    graph.passes[pass].uses.push_back({image, access, true});
+    graph.images[image].usage |= GetAccessInfo(access).usage;
+    return *this;
+}
+
+RenderGraphPassBuilder& RenderGraphPassBuilder::SetSideEffects() {
+    graph.passes[pass].side_effects = true;
+    return *this;
+}
+
+RenderGraphPassBuilder& RenderGraphPassBuilder::SetOpen() {
+    graph.passes[pass].open = true;
+    return *this;
+}
+
+RenderGraphImage RenderGraph::CreateImage(std::string name,
+                                          const RenderGraphImageDesc& desc) {
+    Image image{};
+    image.name = std::move(name);
+    image.desc = desc;
+
+    images.push_back(std::move(image));
+    return RenderGraphImage(images.size() - 1);
+}
+
+RenderGraphImage RenderGraph::ImportImage(std::string name, VkImage image,
+                                          VkImageView view, VkFormat format,
+                                          VkExtent2D extent,
+                                          VkImageLayout layout,
+                                          VkImageLayout final_layout) {
+    Image imported{};
+    imported.name = std::move(name);
+    imported.desc.format = format;
+    imported.desc.width = extent.width;
+    imported.desc.height = extent.height;
+    imported.imported = true;
+    imported.initial_layout = layout;
+    imported.final_layout = final_layout;
+    imported.image = image;
+    imported.view = view;
+
+    images.push_back(std::move(imported));
+    return RenderGraphImage(images.size() - 1);
+}
+
+RenderGraphImage RenderGraph::GetSwapchainImage() {
+    if (!swapchain_image) {
+        // Its contents are not kept between frames
+        swapchain_image = ImportImage(
+            "Swapchain", VK_NULL_HANDLE, VK_NULL_HANDLE,
+            vkb_swapchain.image_format, vkb_swapchain.extent,
+            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    }
+
+    return swapchain_image.value();
+}
+
+void RenderGraph::BindSwapchainImage(VkImage image, VkImageView view) {
+    auto& swapchain = images[GetSwapchainImage()];
+
+    // The swapchain may have been recreated since the passes were added
+    swapchain.desc.format = vkb_swapchain.image_format;
+    swapchain.desc.width = vkb_swapchain.extent.width;
+    swapchain.desc.height = vkb_swapchain.extent.height;
+    swapchain.image = image;
+    swapchain.view = view;
+}
+
+void RenderGraph::AddPass(std::string name, const RenderGraphSetup& setup,
+                          RenderGraphExecute execute) {
+    Pass pass{};
+    pass.name = std::move(name);
+    pass.execute = std::move(execute);
+
+    passes.push_back(std::move(pass));
+
+    RenderGraphPassBuilder builder{*this, passes.size() - 1};
+    setup(builder);
+}
+
+void RenderGraph::Cull() {
+    // Walks back from the passes that produce something visible. A pass can
+    // only read what earlier passes wrote, so declaration order is already a
+    // valid execution order
+    std::vector<bool> needed(images.size(), false);
+    for (size_t i = 0; i < images.size(); i++) {
+        needed[i] = images[i].imported;
+    }
+
+    for (size_t i = passes.size(); i-- > 0;) {
+        auto& pass = passes[i];
+
+        bool keep = pass.side_effects;
+        for (auto& use : pass.uses) {
+            keep = keep || (use.write && needed[use.image]);
+        }
+
+        pass.culled = !keep;
+        if (pass.culled) {
+            continue;
+        }
+
+        for (auto& use : pass.uses) {
+            needed[use.image] = true;
+        }
+    }
+}
+
+void RenderGraph::ComputeLifetimes() {
+    size_t index = 0;
+
+    for (auto& pass : passes) {
+        if (pass.culled) {
+            continue;
+        }
+
+        for (auto& use : pass.uses) {
+            auto& image = images[use.image];
+            image.first_use = std::min(image.first_use, index);
+            image.last_use = std::max(image.last_use, index);
+
+            if (use.write) {
+                image.first_write = std::min(image.first_write, index);
+            }
+        }
+
+        index++;
+    }
+}
+
+bool RenderGraph::Allocate() {
+    std::vector<size_t> transients;
+    for (size_t i = 0; i < images.size(); i++) {
+        if (!images[i].imported && images[i].first_use != SIZE_MAX) {
+            transients.push_back(i);
+        }
+    }
+
+    std::vector<uint64_t> key;
+    key.push_back(vkb_swapchain.extent.width);
+    key.push_back(vkb_swapchain.extent.height);
+
+    for (auto i : transients) {
+        auto& image = images[i];
+        key.push_back(uint64_t(image.desc.format));
+        key.push_back(image.desc.width);
+        key.push_back(image.desc.height);
+        key.push_back(uint64_t(image.desc.samples));
+        key.push_back(image.usage);
+        key.push_back(image.first_use);
+        key.push_back(image.last_use);
+    }
+
+    if (key != physical.key) {
+        RetirePhysical();
+        physical.key = std::move(key);
+
+        std::vector<VkMemoryRequirements> requirements;
+
+        for (auto i : transients) {
+            auto& image = images[i];
+
+            VkImageCreateInfo image_info{};
+            image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            image_info.imageType = VK_IMAGE_TYPE_2D;
+            image_info.format = image.desc.format;
+            image_info.extent.width = image.desc.width != 0
+                                          ? image.desc.width
+                                          : vkb_swapchain.extent.width;
+            image_info.extent.height = image.desc.height != 0
+                                           ? image.desc.height
+                                           : vkb_swapchain.extent.height;
+            image_info.extent.depth = 1;
+            image_info.mipLevels = 1;
+            image_info.arrayLayers = 1;
+            image_info.samples = image.desc.samples;
+            image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+            image_info.usage = image.usage;
+            image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+            VkImage handle;
+            if (vkCreateImage(vkb_device.device, &image_info,
+                              vkb_device.allocation_callbacks,
+                              &handle) != VK_SUCCESS) {
+                println("Could not create render graph image {}", image.name);
+                return false;
+            }
+
+            physical.images.push_back(handle);
+
+            VkMemoryRequirements memory_requirements;
+            vkGetImageMemoryRequirements(vkb_device.device, handle,
+                                         &memory_requirements);
+            requirements.push_back(memory_requirements);
+        }
+
+        // Largest first, each image goes into the first region whose
+        // occupants are all dead by the time it is first used
+        struct Region {
+            uint32_t memory_type;
+            VkDeviceSize offset;
+            VkDeviceSize size;
+            std::vector<size_t> occupants;
+        };
+
+        std::vector<Region> regions;
+        std::vector<size_t> image_region(transients.size());
+        std::vector<VkDeviceSize> block_sizes(VK_MAX_MEMORY_TYPES, 0);
+        std::vector<VkDeviceSize> block_alignments(VK_MAX_MEMORY_TYPES, 1);
+
+        std::vector<size_t> order(transients.size());
+        std::iota(order.begin(), order.end(), size_t(0));
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return requirements[a].size > requirements[b].size;
+        });
+
+        for (auto t : order) {
+            auto& image = images[transients[t]];
+            auto& requirement = requirements[t];
+
+            auto memory_type = FindMemoryType(requirement.memoryTypeBits);
+            if (!memory_type) {
+                println("No memory type for render graph image {}",
+                        image.name);
+                return false;
+            }
+
+            physical.unaliased_size += requirement.size;
+
+            auto fits = [&](const Region& region) {
+                if (region.memory_type != memory_type.value() ||
+                    region.size < requirement.size ||
+                    region.offset % requirement.alignment != 0) {
+                    return false;
+                }
+
+                for (auto occupant : region.occupants) {
+                    auto& other = images[transients[occupant]];
+                    if (image.first_use <= other.last_use &&
+                        other.first_use <= image.last_use) {
+                        return false;
+                    }
+                }
+
+                return true;
+            };
+
+            auto region = std::find_if(regions.begin(), regions.end(), fits);
+
+            if (region == regions.end()) {
+                auto& block_size = block_sizes[memory_type.value()];
+                auto& block_alignment = block_alignments[memory_type.value()];
+                auto offset = AlignUp(block_size, requirement.alignment);
+                block_size = offset + requirement.size;
+                block_alignment =
+                    std::max(block_alignment, requirement.alignment);
+
+                regions.push_back(
+                    {memory_type.value(), offset, requirement.size, {}});
+                region = regions.end() - 1;
+            }
+
+            region->occupants.push_back(t);
+            image_region[t] = size_t(region - regions.begin());
+        }
+
+        std::vector<VmaAllocation> memory(VK_MAX_MEMORY_TYPES,
+                                          VK_NULL_HANDLE);
+
+        for (uint32_t type = 0; type < VK_MAX_MEMORY_TYPES; type++) {
+            if (block_sizes[type] == 0) {
+                continue;
+            }
+
+            // Dedicated, so the region offsets are offsets into the memory
+            VkMemoryRequirements block_requirements{};
+            block_requirements.size = block_sizes[type];
+            block_requirements.alignment = block_alignments[type];
+            block_requirements.memoryTypeBits = 1u << type;
+
+            auto allocation =
+                memory_allocator.AllocateMemory(block_requirements, true);
+            if (!allocation) {
+                return false;
+            }
+
+            memory[type] = allocation.value();
+
+            physical.blocks.push_back({type, block_sizes[type], memory[type]});
+            physical.aliased_size += block_sizes[type];
+        }
+
+        physical.alias_stages.assign(transients.size(), 0);
+        physical.alias_access.assign(transients.size(), 0);
+
+        for (size_t t = 0; t < transients.size(); t++) {
+            auto& region = regions[image_region[t]];
+
+            vmaBindImageMemory2(memory_allocator.Get(),
+                                memory[region.memory_type], region.offset,
+                                physical.images[t], nullptr);
+
+            // The previous occupant, or last frame's use of the same memory
+            for (auto occupant : region.occupants) {
+                for (auto& pass : passes) {
+                    if (pass.culled) {
+                        continue;
+                    }
+
+                    for (auto& use : pass.uses) {
+                        if (use.image != transients[occupant]) {
+                            continue;
+                        }
+
+                        auto info = GetAccessInfo(use.access);
+                        physical.alias_stages[t] |= info.stage;
+                        physical.alias_access[t] |= info.access;
+                    }
+                }
+            }
+
+            auto& image = images[transients[t]];
+
+            VkImageViewCreateInfo view_info{};
+            view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            view_info.image = physical.images[t];
+            view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            view_info.format = image.desc.format;
+            view_info.subresourceRange = {GetAspect(image.desc.format), 0, 1,
+                                          0, 1};
+
+            // Depth is read through the depth aspect only
+            if (IsDepthFormat(image.desc.format)) {
+                view_info.subresourceRange.aspectMask =
+                    VK_IMAGE_ASPECT_DEPTH_BIT;
+            }
+
+            VkImageView view;
+            if (vkCreateImageView(vkb_device.device, &view_info,
+                                  vkb_device.allocation_callbacks,
+                                  &view) != VK_SUCCESS) {
+                println("Could not create render graph view {}", image.name);
+                return false;
+            }
+
+            physical.views.push_back(view);
+        }
+    }
+
+    for (size_t t = 0; t < transients.size(); t++) {
+        images[transients[t]].image = physical.images[t];
+        images[transients[t]].view = physical.views[t];
+    }
+
+    return true;
+}
+
+void RenderGraph::BuildBarriers() {
+    struct State {
+        VkPipelineStageFlags2 stage;
+        VkAccessFlags2 access;
+        VkImageLayout layout;
+        bool written;
+    };
+
+    std::vector<State> states(images.size());
+
+    size_t transient = 0;
+    for (size_t i = 0; i < images.size(); i++) {
+        auto& image = images[i];
+
+        if (image.imported) {
+            // Nothing is known about the work before the graph
+            states[i] = {VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                         VK_ACCESS_2_MEMORY_WRITE_BIT, image.initial_layout,
+                         true};
+        } else if (image.first_use != SIZE_MAX) {
+            states[i] = {physical.alias_stages[transient],
+                         physical.alias_access[transient],
+                         VK_IMAGE_LAYOUT_UNDEFINED, true};
+            transient++;
+        }
+    }
+
+    for (auto& pass : passes) {
+        pass.barriers.clear();
+
+        if (pass.culled) {
+            continue;
+        }
+
+        // A pass can use an image more than once, the uses are merged
+        std::vector<std::pair<RenderGraphImage, State>> merged;
+
+        for (auto& use : pass.uses) {
+            auto info = GetAccessInfo(use.access);
+
+            auto it = std::find_if(merged.begin(), merged.end(), [&](auto& m) {
+                return m.first == use.image;
+            });
+
+            if (it == merged.end()) {
+                merged.push_back(
+                    {use.image,
+                     {info.stage, info.access, info.layout, use.write}});
+                continue;
+            }
+
+            auto& state = it->second;
+            state.stage |= info.stage;
+            state.access |= info.access;
+            state.written = state.written || use.write;
+            if (state.layout != info.layout) {
+                state.layout = VK_IMAGE_LAYOUT_GENERAL;
+            }
+        }
+
+        for (auto& [index, next] : merged) {
+            auto& previous = states[index];
+
+            // Reads after reads in the same layout need nothing, later
+            // writes wait for all of them
+            if (previous.layout == next.layout && !previous.written &&
+                !next.written) {
+                previous.stage |= next.stage;
+                previous.access |= next.access;
+                continue;
+            }
+
+            auto& image = images[index];
+
+            VkImageMemoryBarrier2 barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+            barrier.srcStageMask = previous.stage;
+            // Only writes have anything to make available
+            barrier.srcAccessMask = previous.written ? previous.access : 0;
+            barrier.dstStageMask = next.stage;
+            barrier.dstAccessMask = next.access;
+            barrier.oldLayout = previous.layout;
+            barrier.newLayout = next.layout;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = image.image;
+            barrier.subresourceRange = {GetAspect(image.desc.format), 0, 1, 0,
+                                        1};
+
+            pass.barriers.push_back(barrier);
+            previous = next;
+        }
+    }
+
+    final_barriers.clear();
+
+    // Whoever ends an open pass takes care of the images it uses
+    std::vector<bool> open(images.size(), false);
+    for (auto& pass : passes) {
+        if (pass.open && !pass.culled) {
+            for (auto& use : pass.uses) {
+                open[use.image] = true;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < images.size(); i++) {
+        auto& image = images[i];
+        auto& state = states[i];
+
+        if (!image.imported || open[i] ||
+            (state.layout == image.final_layout && !state.written)) {
+            continue;
+        }
+
+        VkImageMemoryBarrier2 barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+        barrier.srcStageMask = state.stage;
+        barrier.srcAccessMask = state.written ? state.access : 0;
+        barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+        barrier.dstAccessMask =
+            VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+        barrier.oldLayout = state.layout;
+        barrier.newLayout = image.final_layout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image.image;
+        barrier.subresourceRange = {GetAspect(image.desc.format), 0, 1, 0, 1};
+
+        final_barriers.push_back(barrier);
+    }
+}
+
+void RenderGraph::EmitBarriers(
+    VkCommandBuffer cmd, const std::vector<VkImageMemoryBarrier2>& barriers) {
+    if (barriers.empty()) {
+        return;
+    }
+
+    if (vk_synchronization2 && !cmd_pipeline_barrier_2) {
+        cmd_pipeline_barrier_2 =
+            reinterpret_cast<PFN_vkCmdPipelineBarrier2KHR>(vkGetDeviceProcAddr(
+                vkb_device.device, "vkCmdPipelineBarrier2KHR"));
+    }
+
+    if (cmd_pipeline_barrier_2) {
+        VkDependencyInfo dependency_info{};
+        dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+        dependency_info.imageMemoryBarrierCount = uint32_t(barriers.size());
+        dependency_info.pImageMemoryBarriers = barriers.data();
+
+        cmd_pipeline_barrier_2(cmd, &dependency_info);
+        return;
+    }
+
+    // The flags used by the graph all fit the original API
+    VkPipelineStageFlags src_stages = 0;
+    VkPipelineStageFlags dst_stages = 0;
+    std::vector<VkImageMemoryBarrier> legacy;
+
+    for (auto& barrier : barriers) {
+        src_stages |= VkPipelineStageFlags(barrier.srcStageMask);
+        dst_stages |= VkPipelineStageFlags(barrier.dstStageMask);
+
+        VkImageMemoryBarrier image_barrier{};
+        image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        image_barrier.srcAccessMask = VkAccessFlags(barrier.srcAccessMask);
+        image_barrier.dstAccessMask = VkAccessFlags(barrier.dstAccessMask);
+        image_barrier.oldLayout = barrier.oldLayout;
+        image_barrier.newLayout = barrier.newLayout;
+        image_barrier.srcQueueFamilyIndex = barrier.srcQueueFamilyIndex;
+        image_barrier.dstQueueFamilyIndex = barrier.dstQueueFamilyIndex;
+        image_barrier.image = barrier.image;
+        image_barrier.subresourceRange = barrier.subresourceRange;
+
+        legacy.push_back(image_barrier);
+    }
+
+    vkCmdPipelineBarrier(cmd, src_stages, dst_stages, 0, 0, nullptr, 0,
+                         nullptr, uint32_t(legacy.size()), legacy.data());
+}
+
+bool RenderGraph::Execute(VkCommandBuffer cmd) {
+    Cull();
+    ComputeLifetimes();
+
+    if (!Allocate()) {
+        // Half built resources are not worth keeping
+        RetirePhysical();
+        Reset();
+        return false;
+    }
+
+    BuildBarriers();
+
+    stats = {};
+    stats.transient_memory = physical.aliased_size;
+    stats.unaliased_memory = physical.unaliased_size;
+    stats.transient_images = physical.images.size();
+
+    executing = 0;
+    bool finished = false;
+
+    for (auto& pass : passes) {
+        if (pass.culled) {
+            stats.culled_passes++;
+            continue;
+        }
+
+        // Nothing can be recorded outside an open pass once it has begun,
+        // and no later pass uses the images these barriers are for
+        if (pass.open) {
+            EmitBarriers(cmd, final_barriers);
+            finished = true;
+        }
+
+        EmitBarriers(cmd, pass.barriers);
+        stats.barriers += pass.barriers.size();
+        stats.passes++;
+
+        pass.execute(cmd, *this);
+        executing++;
+    }
+
+    if (!finished) {
+        EmitBarriers(cmd, final_barriers);
+    }
+
+    stats.barriers += final_barriers.size();
+
+    Reset();
+    return true;
+}
+
+void RenderGraph::Reset() {
+    passes.clear();
+    images.clear();
+    final_barriers.clear();
+    swapchain_image.reset();
+}
+
+VkImage RenderGraph::GetImage(RenderGraphImage image) const {
+    return images[image].image;
+}
+
+VkImageView RenderGraph::GetImageView(RenderGraphImage image) const {
+    return images[image].view;
+}
+
+VkFormat RenderGraph::GetFormat(RenderGraphImage image) const {
+    return images[image].desc.format;
+}
+
+VkExtent2D RenderGraph::GetExtent(RenderGraphImage image) const {
+    auto& desc = images[image].desc;
+    return {desc.width != 0 ? desc.width : vkb_swapchain.extent.width,
+            desc.height != 0 ? desc.height : vkb_swapchain.extent.height};
+}
+
+void RenderGraph::RetirePhysical() {
+    // Frames in flight may still be using them
+    for (auto view : physical.views) {
+        deletion_queue.Push(view);
+    }
+
+    for (auto image : physical.images) {
+        deletion_queue.Push(image);
+    }
+
+    for (auto& block : physical.blocks) {
+        memory_allocator.ReleaseMemory(block.allocation);
+    }
+
+    physical = {};
+}
+
+void RenderGraph::Destroy() {
+    Reset();
+
+    for (auto view : physical.views) {
+        vkDestroyImageView(vkb_device.device, view,
+                           vkb_device.allocation_callbacks);
+    }
+
+    for (auto image : physical.images) {
+        vkDestroyImage(vkb_device.device, image,
+                       vkb_device.allocation_callbacks);
+    }
+
+    for (auto& block : physical.blocks) {
+        memory_allocator.FreeMemory(block.allocation);
+    }
+
+    physical = {};
+}
+
+} // namespace crow
\ No newline at end of file
@@ -1,30 +1,122 @@
 #include <Crow/Renderer.hpp>
 
+#include <Crow/Allocator.hpp>
+#include <Crow/CommandRecorder.hpp>
+#include <Crow/DeletionQueue.hpp>
+#include <Crow/Log.hpp>
+#include <Crow/RenderGraph.hpp>
+#include <Crow/ShaderHotReload.hpp>
+#include <Crow/Swapchain.hpp>
+#include <Crow/Timeline.hpp>
+#include <Crow/UploadRing.hpp>
+#include <Crow/Uploader.hpp>
 #include <Crow/Vulkan.hpp>
 
 namespace crow {
 
-void Renderer::StartFrame() {
+namespace {
+
+// Loaded from the device the first time dynamic rendering is used
+PFN_vkCmdBeginRenderingKHR cmd_begin_rendering = nullptr;
+PFN_vkCmdEndRenderingKHR cmd_end_rendering = nullptr;
+
+// Without a render pass the swapchain image layouts are changed by hand
+void TransitionSwapchainImage(VkCommandBuffer cmd, VkImage image,
+                              VkImageLayout old_layout,
+                              VkImageLayout new_layout,
+                              VkAccessFlags src_access,
+                              VkAccessFlags dst_access,
+                              VkPipelineStageFlags dst_stage) {
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = src_access;
+    barrier.dstAccessMask = dst_access;
+    barrier.oldLayout = old_layout;
+    barrier.newLayout = new_layout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+    // Acquire waits at, and rendering writes in, the color output stage
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         dst_stage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+} // namespace
+
+void Renderer::WaitForFrame() {
+    if (vk_timeline_semaphores) {
+        if (frame_values.size() != vk_frames_in_flight) {
+            frame_values.assign(vk_frames_in_flight, {});
+        }
+
+        auto& values = frame_values[vk_frame_index];
+        graphics_timeline.Wait(values.graphics);
+        compute_timeline.Wait(values.compute);
+        return;
+    }
+
+    // The compute fence is only reset when compute is submitted, so it is
+    // already signaled for frames without compute work
     vkWaitForFences(vkb_device.device, 1,
                     &vk_graphics_flight_fences[vk_frame_index], VK_TRUE,
                     UINT64_MAX);
-    vkResetFences(vkb_device.device, 1,
-                  &vk_graphics_flight_fences[vk_frame_index]);
-
     vkWaitForFences(vkb_device.device, 1,
                     &vk_compute_flight_fences[vk_frame_index], VK_TRUE,
                     UINT64_MAX);
-    vkResetFences(vkb_device.device, 1,
-                  &vk_compute_flight_fences[vk_frame_index]);
+}
 
-    vkAcquireNextImageKHR(vkb_device.device, vkb_swapchain.swapchain,
-                          UINT64_MAX,
-                          vk_image_available_semaphores[vk_frame_index],
-                          VK_NULL_HANDLE, &current_framebuffer);
+bool Renderer::StartFrame(VkSubpassContents contents) {
+    WaitForFrame();
 
-    // TODO Detect resizes and recreate swapchain
+    deletion_queue.Flush();
+    command_recorder.ResetFrame();
+    upload_ring.ResetFrame();
+    memory_allocator.NewFrame();
+
+    if (swapchain_manager.IsOutOfDate() && !swapchain_manager.Recreate()) {
+        render_graph.Reset();
+        return false;
+    }
+
+    auto result = vkAcquireNextImageKHR(
+        vkb_device.device, vkb_swapchain.swapchain, UINT64_MAX,
+        vk_image_available_semaphores[vk_frame_index], VK_NULL_HANDLE,
+        &current_framebuffer);
+
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        if (!swapchain_manager.Recreate()) {
+            render_graph.Reset();
+            return false;
+        }
+
+        result = vkAcquireNextImageKHR(
+            vkb_device.device, vkb_swapchain.swapchain, UINT64_MAX,
+            vk_image_available_semaphores[vk_frame_index], VK_NULL_HANDLE,
+            &current_framebuffer);
+    }
+
+    if (result == VK_SUBOPTIMAL_KHR) {
+        // The image is still usable, recreate once it has been presented
+        swapchain_manager.Invalidate();
+    } else if (result != VK_SUCCESS) {
+        println("Could not acquire swapchain image");
+        render_graph.Reset();
+        return false;
+    }
+
+    // Only reset once a frame is sure to be submitted, otherwise the next
+    // wait on it would never return
+    if (!vk_timeline_semaphores) {
+        vkResetFences(vkb_device.device, 1,
+                      &vk_graphics_flight_fences[vk_frame_index]);
+    }
+
+    compute_state = ComputeState::Empty;
+    compute_wait_stages = 0;
+    compute_value = 0;
 
-    vkResetCommandBuffer(vk_cmd_graphics[vk_frame_index], 0);
     vkResetCommandBuffer(vk_cmd_graphics[vk_frame_index], 0);
 
     VkCommandBufferBeginInfo begin_info{};
@@ -32,67 +124,248 @@ void Renderer::StartFrame() {
 
     vkBeginCommandBuffer(vk_cmd_graphics[vk_frame_index], &begin_info);
 
+    // Takes ownership of finished uploads before anything can use them, and
+    // starts copying whatever was uploaded since the last frame
+    uploader.Update(vk_cmd_graphics[vk_frame_index]);
+    uploader.Submit();
+
+    render_pass_contents = contents;
+
+    // Passes added since the last frame may already have drawn to the
+    // swapchain image, the swapchain pass keeps what they drew
+    auto swapchain_image = render_graph.GetSwapchainImage();
+    render_graph.BindSwapchainImage(vk_images[current_framebuffer],
+                                    vk_image_views[current_framebuffer]);
+
+    render_graph.AddPass(
+        "Swapchain",
+        [&](RenderGraphPassBuilder& builder) {
+            builder.Write(swapchain_image, RenderGraphAccess::ColorAttachment)
+                .SetSideEffects()
+                .SetOpen();
+        },
+        [this, swapchain_image](VkCommandBuffer cmd, const RenderGraph& graph) {
+            BeginSwapchainPass(cmd, graph.HasContents(swapchain_image));
+        });
+
+    if (!render_graph.Execute(vk_cmd_graphics[vk_frame_index])) {
+        println("Could not execute the render graph");
+
+        // Nothing was recorded, so the image is still undefined
+        TransitionSwapchainImage(
+            vk_cmd_graphics[vk_frame_index], vk_images[current_framebuffer],
+            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            0, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+        BeginSwapchainPass(vk_cmd_graphics[vk_frame_index], false);
+    }
+
+    return true;
+}
+
+void Renderer::BeginSwapchainPass(VkCommandBuffer cmd, bool load) {
+    if (vk_dynamic_rendering) {
+        BeginRendering(cmd, load);
+        return;
+    }
+
+    // Both render passes are compatible with the framebuffers
     VkRenderPassBeginInfo render_pass_info{};
     render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    render_pass_info.renderPass = vk_render_passes[vk_frame_index];
-    render_pass_info.framebuffer = vk_framebuffers[vk_frame_index];
+    render_pass_info.renderPass = load ? vk_load_render_pass : vk_render_pass;
+    render_pass_info.framebuffer = vk_framebuffers[current_framebuffer];
     render_pass_info.renderArea.offset = {0, 0};
     render_pass_info.renderArea.extent = vkb_swapchain.extent;
 
     VkClearValue clear_color = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
-    clear_color.depthStencil.depth = 0.0f;
-    clear_color.depthStencil.stencil = 0;
 
     render_pass_info.clearValueCount = 1;
     render_pass_info.pClearValues = &clear_color;
 
-    vkCmdBeginRenderPass(vk_cmd_graphics[vk_frame_index], &render_pass_info,
-                         VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBeginRenderPass(cmd, &render_pass_info, render_pass_contents);
+}
+
+void Renderer::BeginRendering(VkCommandBuffer cmd, bool load) {
+    if (!cmd_begin_rendering) {
+        cmd_begin_rendering = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(
+            vkGetDeviceProcAddr(vkb_device.device, "vkCmdBeginRenderingKHR"));
+        cmd_end_rendering = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(
+            vkGetDeviceProcAddr(vkb_device.device, "vkCmdEndRenderingKHR"));
+    }
+
+    // The render graph has already moved the image to the attachment layout
+    VkRenderingAttachmentInfo color_attachment{};
+    color_attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    color_attachment.imageView = vk_image_views[current_framebuffer];
+    color_attachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    color_attachment.loadOp =
+        load ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+    color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    color_attachment.clearValue = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
+
+    VkRenderingInfo rendering_info{};
+    rendering_info.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+    rendering_info.renderArea.offset = {0, 0};
+    rendering_info.renderArea.extent = vkb_swapchain.extent;
+    rendering_info.layerCount = 1;
+    rendering_info.colorAttachmentCount = 1;
+    rendering_info.pColorAttachments = &color_attachment;
+
+    if (render_pass_contents ==
+        VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS) {
+        rendering_info.flags =
+            VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+    }
 
-    vkBeginCommandBuffer(vk_cmd_compute[vk_frame_index], &begin_info);
+    cmd_begin_rendering(cmd, &rendering_info);
 }
 
-void Renderer::SubmitFrame() {
-    vkEndCommandBuffer(vk_cmd_compute[vk_frame_index]);
+void Renderer::EndRendering() {
+    auto cmd = vk_cmd_graphics[vk_frame_index];
 
-    vkCmdEndRenderPass(vk_cmd_graphics[vk_frame_index]);
-    vkEndCommandBuffer(vk_cmd_graphics[vk_frame_index]);
+    cmd_end_rendering(cmd);
 
-    {
-        VkSubmitInfo compute_submit_info{};
-        compute_submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        compute_submit_info.commandBufferCount = 1;
-        compute_submit_info.pCommandBuffers = &vk_cmd_compute[vk_frame_index];
+    // Presentation is ordered by the render finished semaphore instead
+    TransitionSwapchainImage(cmd, vk_images[current_framebuffer],
+                             VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                             VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                             VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, 0,
+                             VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+}
+
+bool Renderer::RecordParallel(size_t count, const RecordFunction& record,
+                              size_t min_chunk_size) {
+    if (render_pass_contents != VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS) {
+        println("RecordParallel needs a frame started with "
+                "VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS");
+        return false;
+    }
+
+    VkCommandBufferInheritanceRenderingInfo rendering_inheritance{};
+    rendering_inheritance.sType =
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+    rendering_inheritance.colorAttachmentCount = 1;
+    rendering_inheritance.pColorAttachmentFormats = &vkb_swapchain.image_format;
+    rendering_inheritance.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkCommandBufferInheritanceInfo inheritance{};
+    inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+
+    if (vk_dynamic_rendering) {
+        inheritance.pNext = &rendering_inheritance;
+    } else {
+        inheritance.renderPass = vk_render_pass;
+        inheritance.subpass = 0;
+        inheritance.framebuffer = vk_framebuffers[current_framebuffer];
+    }
+
+    return command_recorder.Record(vk_cmd_graphics[vk_frame_index],
+                                   inheritance, count, record,
+                                   min_chunk_size);
+}
+
+VkCommandBuffer Renderer::GetComputeCommandBuffer() {
+    auto cmd = vk_cmd_compute[vk_frame_index];
+
+    if (compute_state == ComputeState::Submitted) {
+        println("Compute work recorded after SubmitCompute is ignored");
+    }
+
+    if (compute_state != ComputeState::Empty) {
+        return cmd;
+    }
+
+    vkResetCommandBuffer(cmd, 0);
+
+    VkCommandBufferBeginInfo begin_info{};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkBeginCommandBuffer(cmd, &begin_info);
+    uploader.RecordComputeAcquires(cmd);
+
+    compute_state = ComputeState::Recording;
+    return cmd;
+}
+
+void Renderer::SubmitCompute() {
+    if (compute_state != ComputeState::Recording) {
+        return;
+    }
+
+    compute_state = ComputeState::Submitted;
+    upload_ring.Flush();
+
+    auto cmd = vk_cmd_compute[vk_frame_index];
+    vkEndCommandBuffer(cmd);
+
+    VkSubmitInfo compute_submit_info{};
+    compute_submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    compute_submit_info.commandBufferCount = 1;
+    compute_submit_info.pCommandBuffers = &cmd;
+
+    if (vk_timeline_semaphores) {
+        compute_value = compute_timeline.Next();
+        frame_values[vk_frame_index].compute = compute_value;
+
+        auto signal_semaphore = compute_timeline.Get();
+
+        VkTimelineSemaphoreSubmitInfo timeline_info{};
+        timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timeline_info.signalSemaphoreValueCount = 1;
+        timeline_info.pSignalSemaphoreValues = &compute_value;
+
+        compute_submit_info.pNext = &timeline_info;
+        compute_submit_info.signalSemaphoreCount = 1;
+        compute_submit_info.pSignalSemaphores = &signal_semaphore;
+
+        vkQueueSubmit(vk_compute_queue, 1, &compute_submit_info,
+                      VK_NULL_HANDLE);
+        return;
+    }
+
+    // A binary semaphore has to be waited on once signaled, so it is only
+    // signaled when graphics declared a dependency
+    if (compute_wait_stages != 0) {
         compute_submit_info.signalSemaphoreCount = 1;
         compute_submit_info.pSignalSemaphores =
             &vk_compute_finished_semaphores[vk_frame_index];
+    }
 
-        vkQueueSubmit(vk_compute_queue, 1, &compute_submit_info,
-                      vk_compute_flight_fences[vk_frame_index]);
+    vkResetFences(vkb_device.device, 1,
+                  &vk_compute_flight_fences[vk_frame_index]);
+
+    vkQueueSubmit(vk_compute_queue, 1, &compute_submit_info,
+                  vk_compute_flight_fences[vk_frame_index]);
+}
+
+void Renderer::WaitForCompute(VkPipelineStageFlags stage) {
+    if (compute_state == ComputeState::Submitted && !vk_timeline_semaphores &&
+        compute_wait_stages == 0) {
+        println("WaitForCompute must come before SubmitCompute without "
+                "timeline semaphores");
+        return;
     }
 
-    {
-        VkSemaphore wait_semaphores[] = {
-            vk_compute_finished_semaphores[vk_frame_index],
-            vk_image_available_semaphores[vk_frame_index]};
+    compute_wait_stages |= stage;
+}
+
+void Renderer::SubmitFrame() {
+    SubmitCompute();
 
-        VkPipelineStageFlags wait_stages[] = {
-            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+    if (vk_dynamic_rendering) {
+        EndRendering();
+    } else {
+        vkCmdEndRenderPass(vk_cmd_graphics[vk_frame_index]);
+    }
 
-        VkSubmitInfo graphics_submit_info{};
-        graphics_submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        graphics_submit_info.commandBufferCount = 1;
-        graphics_submit_info.pCommandBuffers = &vk_cmd_graphics[vk_frame_index];
-        graphics_submit_info.waitSemaphoreCount = 2;
-        graphics_submit_info.pWaitSemaphores = wait_semaphores;
-        graphics_submit_info.pWaitDstStageMask = wait_stages;
-        graphics_submit_info.signalSemaphoreCount = 1;
-        graphics_submit_info.pSignalSemaphores =
-            &vk_render_finished_semaphores[vk_frame_index];
+    vkEndCommandBuffer(vk_cmd_graphics[vk_frame_index]);
+    upload_ring.Flush();
 
-        vkQueueSubmit(vk_graphics_queue, 1, &graphics_submit_info,
-                      vk_graphics_flight_fences[vk_frame_index]);
+    if (vk_timeline_semaphores) {
+        SubmitGraphicsWithTimelines();
+    } else {
+        SubmitGraphicsWithFences();
     }
 
     {
@@ -100,16 +373,100 @@ void Renderer::SubmitFrame() {
         present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
         present_info.waitSemaphoreCount = 1;
         present_info.pWaitSemaphores =
-            &vk_render_finished_semaphores[vk_frame_index];
+            &vk_render_finished_semaphores[current_framebuffer];
         present_info.swapchainCount = 1;
         present_info.pSwapchains = &vkb_swapchain.swapchain;
         present_info.pImageIndices = &current_framebuffer;
 
-        vkQueuePresentKHR(vk_present_queue, &present_info);
+        auto result = vkQueuePresentKHR(vk_present_queue, &present_info);
+
+        if (result == VK_ERROR_OUT_OF_DATE_KHR ||
+            result == VK_SUBOPTIMAL_KHR) {
+            swapchain_manager.Invalidate();
+        }
     }
 
     vk_frame_index++;
-    vk_frame_index %= vkb_swapchain.image_count;
+    vk_frame_index %= vk_frames_in_flight;
+    vk_frame_count++;
+
+#ifndef CROW_NO_SHADERC
+    // Swap in recompiled shaders between this frame and the next one
+    shader_hot_reloader.ApplyPendingReloads();
+#endif
+}
+
+void Renderer::SubmitGraphicsWithTimelines() {
+    auto graphics_value = graphics_timeline.Next();
+
+    std::vector<VkSemaphore> wait_semaphores{
+        vk_image_available_semaphores[vk_frame_index]};
+    // Binary semaphores ignore their value
+    std::vector<uint64_t> wait_values{0};
+    std::vector<VkPipelineStageFlags> wait_stages{
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+
+    if (compute_value != 0 && compute_wait_stages != 0) {
+        wait_semaphores.push_back(compute_timeline.Get());
+        wait_values.push_back(compute_value);
+        wait_stages.push_back(compute_wait_stages);
+    }
+
+    VkSemaphore signal_semaphores[] = {
+        graphics_timeline.Get(),
+        vk_render_finished_semaphores[current_framebuffer]};
+
+    uint64_t signal_values[] = {graphics_value, 0};
+
+    VkTimelineSemaphoreSubmitInfo timeline_info{};
+    timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timeline_info.waitSemaphoreValueCount = uint32_t(wait_values.size());
+    timeline_info.pWaitSemaphoreValues = wait_values.data();
+    timeline_info.signalSemaphoreValueCount = 2;
+    timeline_info.pSignalSemaphoreValues = signal_values;
+
+    VkSubmitInfo graphics_submit_info{};
+    graphics_submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    graphics_submit_info.pNext = &timeline_info;
+    graphics_submit_info.commandBufferCount = 1;
+    graphics_submit_info.pCommandBuffers = &vk_cmd_graphics[vk_frame_index];
+    graphics_submit_info.waitSemaphoreCount = uint32_t(wait_semaphores.size());
+    graphics_submit_info.pWaitSemaphores = wait_semaphores.data();
+    graphics_submit_info.pWaitDstStageMask = wait_stages.data();
+    graphics_submit_info.signalSemaphoreCount = 2;
+    graphics_submit_info.pSignalSemaphores = signal_semaphores;
+
+    vkQueueSubmit(vk_graphics_queue, 1, &graphics_submit_info,
+                  VK_NULL_HANDLE);
+
+    frame_values[vk_frame_index].graphics = graphics_value;
+}
+
+void Renderer::SubmitGraphicsWithFences() {
+    std::vector<VkSemaphore> wait_semaphores{
+        vk_image_available_semaphores[vk_frame_index]};
+    std::vector<VkPipelineStageFlags> wait_stages{
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+
+    if (compute_state == ComputeState::Submitted && compute_wait_stages != 0) {
+        wait_semaphores.push_back(
+            vk_compute_finished_semaphores[vk_frame_index]);
+        wait_stages.push_back(compute_wait_stages);
+    }
+
+    VkSubmitInfo graphics_submit_info{};
+    graphics_submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    graphics_submit_info.commandBufferCount = 1;
+    graphics_submit_info.pCommandBuffers = &vk_cmd_graphics[vk_frame_index];
+    graphics_submit_info.waitSemaphoreCount = uint32_t(wait_semaphores.size());
+    graphics_submit_info.pWaitSemaphores = wait_semaphores.data();
+    graphics_submit_info.pWaitDstStageMask = wait_stages.data();
+    graphics_submit_info.signalSemaphoreCount = 1;
+    graphics_submit_info.pSignalSemaphores =
+        &vk_render_finished_semaphores[current_framebuffer];
+
+    vkQueueSubmit(vk_graphics_queue, 1, &graphics_submit_info,
+                  vk_graphics_flight_fences[vk_frame_index]);
 }
 
 } // namespace crow
\ No newline at end of file
@@ -1,129 +1,351 @@
 #include <Crow/Shader.hpp>
 
+#ifndef CROW_NO_SHADERC
 #include <shaderc/shaderc.h>
+#endif
 
+#include <Crow/Hash.hpp>
 #include <Crow/Log.hpp>
+#include <Crow/ShaderCache.hpp>
+#include <Crow/ShaderInclude.hpp>
+#include <Crow/ThreadPool.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <memory>
 
 namespace crow {
 
-std::vector<uint32_t> CompileGLSLShader(const std::string& file_name,
-                                        const std::string& code,
-                                        VkShaderStageFlagBits stage,
-                                        const std::string& include_path,
-                                        bool gen_debug) {
-    shaderc_shader_kind shader_kind;
+#ifndef CROW_NO_SHADERC
+
+namespace {
+
+// Bump whenever the options set in the ShaderCompiler templates change so
+// that stale cache entries are not reused
+constexpr uint32_t compile_options_version = 2;
+
+struct ThreadCompiler {
+    shaderc_compiler_t compiler = shaderc_compiler_initialize();
+
+    ~ThreadCompiler() { shaderc_compiler_release(compiler); }
+};
+
+shaderc_compiler_t GetThreadCompiler() {
+    thread_local ThreadCompiler thread_compiler;
+    return thread_compiler.compiler;
+}
+
+std::optional<shaderc_shader_kind> GetShaderKind(VkShaderStageFlagBits stage) {
     switch (stage) {
     case VK_SHADER_STAGE_VERTEX_BIT:
-        shader_kind = shaderc_glsl_default_vertex_shader;
-        break;
+        return shaderc_glsl_default_vertex_shader;
 
     case VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT:
-        shader_kind = shaderc_glsl_default_tess_control_shader;
-        break;
+        return shaderc_glsl_default_tess_control_shader;
 
     case VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT:
-        shader_kind = shaderc_glsl_default_tess_evaluation_shader;
-        break;
+        return shaderc_glsl_default_tess_evaluation_shader;
 
     case VK_SHADER_STAGE_GEOMETRY_BIT:
-        shader_kind = shaderc_glsl_default_geometry_shader;
-        break;
+        return shaderc_glsl_default_geometry_shader;
 
     case VK_SHADER_STAGE_FRAGMENT_BIT:
-        shader_kind = shaderc_glsl_default_fragment_shader;
-        break;
+        return shaderc_glsl_default_fragment_shader;
 
     case VK_SHADER_STAGE_COMPUTE_BIT:
-        shader_kind = shaderc_glsl_default_compute_shader;
-        break;
+        return shaderc_glsl_default_compute_shader;
 
     case VK_SHADER_STAGE_RAYGEN_BIT_KHR:
-        shader_kind = shaderc_glsl_default_raygen_shader;
-        break;
+        return shaderc_glsl_default_raygen_shader;
 
     case VK_SHADER_STAGE_ANY_HIT_BIT_KHR:
-        shader_kind = shaderc_glsl_default_anyhit_shader;
-        break;
+        return shaderc_glsl_default_anyhit_shader;
 
     case VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR:
-        shader_kind = shaderc_glsl_default_closesthit_shader;
-        break;
+        return shaderc_glsl_default_closesthit_shader;
 
     case VK_SHADER_STAGE_MISS_BIT_KHR:
-        shader_kind = shaderc_glsl_default_miss_shader;
-        break;
+        return shaderc_glsl_default_miss_shader;
 
     case VK_SHADER_STAGE_INTERSECTION_BIT_KHR:
-        shader_kind = shaderc_glsl_default_intersection_shader;
-        break;
+        return shaderc_glsl_default_intersection_shader;
 
     case VK_SHADER_STAGE_CALLABLE_BIT_KHR:
-        shader_kind = shaderc_glsl_default_callable_shader;
-        break;
+        return shaderc_glsl_default_callable_shader;
 
     case VK_SHADER_STAGE_TASK_BIT_EXT:
-        shader_kind = shaderc_glsl_default_task_shader;
-        break;
+        return shaderc_glsl_default_task_shader;
 
     case VK_SHADER_STAGE_MESH_BIT_EXT:
-        shader_kind = shaderc_glsl_default_mesh_shader;
-        break;
+        return shaderc_glsl_default_mesh_shader;
 
     default:
-        println("Unknown shader type {}", int(stage));
         return {};
     }
+}
 
-    auto compiler = shaderc_compiler_initialize();
-    auto options = shaderc_compile_options_initialize();
+struct IncludeContext {
+    const std::string* include_path;
+    std::vector<std::shared_ptr<const ShaderIncludeFile>> included;
+};
+
+struct IncludeResult {
+    shaderc_include_result result;
+    std::string error;
+};
+
+shaderc_include_result* ResolveInclude(void* user_data,
+                                       const char* requested_source, int type,
+                                       const char* requesting_source,
+                                       size_t include_depth) {
+    auto context = static_cast<IncludeContext*>(user_data);
+
+    auto include = new IncludeResult{};
+    include->result.user_data = include;
+
+    if (include_depth > ShaderIncluder::max_include_depth) {
+        include->error = std::format("Include depth exceeded including {}",
+                                     requested_source);
+    } else {
+        auto file = shader_includer.Resolve(
+            requested_source, type == shaderc_include_type_relative,
+            requesting_source, *context->include_path);
+
+        if (file) {
+            include->result.source_name = file->path.c_str();
+            include->result.source_name_length = file->path.size();
+            include->result.content = file->contents.c_str();
+            include->result.content_length = file->contents.size();
+
+            // Keeps the contents alive until the compile is done
+            context->included.push_back(std::move(file));
+
+            return &include->result;
+        }
 
-    if (gen_debug) {
-        shaderc_compile_options_add_macro_definition(options, "DEBUG", 5, NULL,
-                                                     0);
-        shaderc_compile_options_set_generate_debug_info(options);
+        include->error =
+            std::format("Could not find include file {}", requested_source);
     }
 
-    shaderc_compile_options_set_optimization_level(
-        options, shaderc_optimization_level_performance);
+    // An empty source name tells shaderc that the include failed, the content
+    // is used as the error message
+    include->result.source_name = "";
+    include->result.source_name_length = 0;
+    include->result.content = include->error.c_str();
+    include->result.content_length = include->error.size();
+
+    return &include->result;
+}
+
+void ReleaseInclude(void*, shaderc_include_result* include_result) {
+    delete static_cast<IncludeResult*>(include_result->user_data);
+}
 
-    std::vector<char> path;
-    path.resize(include_path.size() + 1);
-    for (size_t i = 0; i < include_path.size() + 1; i++) {
-        path[i] = include_path[i];
+uint64_t GetShaderCacheKey(const std::string& file_name,
+                           const std::string& code,
+                           VkShaderStageFlagBits stage,
+                           const std::string& include_path,
+                           const ShaderCompileSettings& settings,
+                           const std::vector<ShaderDefine>& defines) {
+    unsigned int spv_version, spv_revision;
+    shaderc_get_spv_version(&spv_version, &spv_revision);
+
+    auto key = HashString(code);
+    key = HashString(file_name, key);
+    key = HashString(include_path, key);
+    key = HashValue(stage, key);
+    key = HashValue(settings.gen_debug, key);
+    key = HashValue(settings.optimization, key);
+    key = HashValue(settings.target_env, key);
+    // The include directories decide which files get included, their contents
+    // are checked through the dependencies stored in the cache entry
+    auto& include_directories = shader_includer.GetIncludeDirectories();
+    key = HashValue(include_directories.size(), key);
+    for (auto& directory : include_directories) {
+        key = HashString(ShaderIncluder::NormalizePath(directory), key);
     }
 
-    shaderc_compile_options_set_include_callbacks(
-        options,
-        [](void* user_data, const char* requested_source, int type,
-           const char* requesting_source,
-           size_t include_depth) -> shaderc_include_result* {
-            // TODO Resolve include lookup
-        },
+    key = HashValue(defines.size(), key);
+    for (auto& define : defines) {
+        key = HashString(define.name, key);
+        key = HashString(define.value, key);
+    }
+
+    key = HashValue(compile_options_version, key);
+    key = HashValue(spv_version, key);
+    key = HashValue(spv_revision, key);
+
+    return key;
+}
+
+// Identifies the variant a shader was compiled as, for its dependencies
+uint64_t GetShaderVariant(const ShaderCompileSettings& settings,
+                          const std::vector<ShaderDefine>& defines) {
+    auto variant = HashValue(settings.gen_debug);
+
+    variant = HashValue(defines.size(), variant);
+    for (auto& define : defines) {
+        variant = HashString(define.name, variant);
+        variant = HashString(define.value, variant);
+    }
+
+    return variant;
+}
+
+} // namespace
+
+ShaderCompiler::ShaderCompiler() {
+    constexpr bool gen_debug_values[] = {false, true};
+
+    constexpr ShaderOptimization optimizations[] = {
+        ShaderOptimization::Zero, ShaderOptimization::Size,
+        ShaderOptimization::Performance};
+
+    constexpr ShaderTargetEnv target_envs[] = {ShaderTargetEnv::Vulkan1_1,
+                                               ShaderTargetEnv::Vulkan1_2,
+                                               ShaderTargetEnv::Vulkan1_3};
+
+    for (auto gen_debug : gen_debug_values) {
+        for (auto optimization : optimizations) {
+            for (auto target_env : target_envs) {
+                ShaderCompileSettings settings{gen_debug, optimization,
+                                               target_env};
+
+                auto options = shaderc_compile_options_initialize();
+
+                if (gen_debug) {
+                    shaderc_compile_options_add_macro_definition(
+                        options, "DEBUG", 5, NULL, 0);
+                    shaderc_compile_options_set_generate_debug_info(options);
+                }
+
+                switch (optimization) {
+                case ShaderOptimization::Zero:
+                    shaderc_compile_options_set_optimization_level(
+                        options, shaderc_optimization_level_zero);
+                    break;
+
+                case ShaderOptimization::Size:
+                    shaderc_compile_options_set_optimization_level(
+                        options, shaderc_optimization_level_size);
+                    break;
+
+                case ShaderOptimization::Performance:
+                    shaderc_compile_options_set_optimization_level(
+                        options, shaderc_optimization_level_performance);
+                    break;
+                }
+
+                switch (target_env) {
+                case ShaderTargetEnv::Vulkan1_1:
+                    shaderc_compile_options_set_target_env(
+                        options, shaderc_target_env_vulkan,
+                        shaderc_env_version_vulkan_1_1);
+                    break;
+
+                case ShaderTargetEnv::Vulkan1_2:
+                    shaderc_compile_options_set_target_env(
+                        options, shaderc_target_env_vulkan,
+                        shaderc_env_version_vulkan_1_2);
+                    break;
+
+                case ShaderTargetEnv::Vulkan1_3:
+                    shaderc_compile_options_set_target_env(
+                        options, shaderc_target_env_vulkan,
+                        shaderc_env_version_vulkan_1_3);
+                    break;
+                }
 
-        [](void* user_data, shaderc_include_result* include_result) -> void {
-            // TODO Delete include lookup
-        },
-        static_cast<void*>(path.data()));
+                shaderc_compile_options_set_auto_bind_uniforms(options, false);
+                shaderc_compile_options_set_auto_combined_image_sampler(
+                    options, false);
 
-    shaderc_compile_options_set_target_env(options, shaderc_target_env_vulkan,
-                                           shaderc_env_version_vulkan_1_2);
+                shaderc_compile_options_set_preserve_bindings(options, false);
 
-    shaderc_compile_options_set_auto_bind_uniforms(options, false);
-    shaderc_compile_options_set_auto_combined_image_sampler(options, false);
+                shaderc_compile_options_set_auto_map_locations(options, false);
 
-    shaderc_compile_options_set_preserve_bindings(options, false);
+                shaderc_compile_options_set_vulkan_rules_relaxed(options,
+                                                                 false);
 
-    shaderc_compile_options_set_auto_map_locations(options, false);
+                shaderc_compile_options_set_invert_y(options, false);
 
-    shaderc_compile_options_set_vulkan_rules_relaxed(options, false);
+                shaderc_compile_options_set_nan_clamp(options, true);
 
-    shaderc_compile_options_set_invert_y(options, false);
+                templates[GetTemplateIndex(settings)] = options;
+            }
+        }
+    }
+}
+
+ShaderCompiler::~ShaderCompiler() {
+    for (auto options : templates) {
+        shaderc_compile_options_release(options);
+    }
+}
 
-    shaderc_compile_options_set_nan_clamp(options, true);
+size_t
+ShaderCompiler::GetTemplateIndex(const ShaderCompileSettings& settings) {
+    return (size_t(settings.gen_debug) * optimization_count +
+            size_t(settings.optimization)) *
+               target_env_count +
+           size_t(settings.target_env);
+}
 
-    auto result = shaderc_compile_into_spv(compiler, code.c_str(), code.size(),
-                                           shader_kind, file_name.c_str(),
-                                           "main", options);
+std::vector<uint32_t>
+ShaderCompiler::Compile(const std::string& file_name, const std::string& code,
+                        VkShaderStageFlagBits stage,
+                        const std::string& include_path,
+                        const ShaderCompileSettings& settings,
+                        const std::vector<ShaderDefine>& defines) const {
+    auto shader_kind = GetShaderKind(stage);
+    if (!shader_kind) {
+        println("Unknown shader type {}", int(stage));
+        return {};
+    }
+
+    uint64_t cache_key = 0;
+    if (shader_cache.IsOpen()) {
+        cache_key = GetShaderCacheKey(file_name, code, stage, include_path,
+                                      settings, defines);
+
+        auto cached =
+            shader_cache.Load(cache_key, [](const std::string& path) {
+                return shader_includer.GetContentHash(path);
+            });
+
+        if (cached) {
+            std::vector<std::string> included;
+            for (auto& dependency : cached->dependencies) {
+                included.push_back(dependency.path);
+            }
+
+            shader_includer.SetDependencies(
+                file_name, GetShaderVariant(settings, defines),
+                std::move(included));
+
+            return std::move(cached->spir_v);
+        }
+    }
+
+    auto options =
+        shaderc_compile_options_clone(templates[GetTemplateIndex(settings)]);
+
+    for (auto& define : defines) {
+        shaderc_compile_options_add_macro_definition(
+            options, define.name.c_str(), define.name.size(),
+            define.value.c_str(), define.value.size());
+    }
+
+    IncludeContext include_context{&include_path, {}};
+
+    shaderc_compile_options_set_include_callbacks(
+        options, ResolveInclude, ReleaseInclude,
+        static_cast<void*>(&include_context));
+
+    auto result = shaderc_compile_into_spv(
+        GetThreadCompiler(), code.c_str(), code.size(), shader_kind.value(),
+        file_name.c_str(), "main", options);
 
     auto status = shaderc_result_get_compilation_status(result);
 
@@ -159,11 +381,8 @@ std::vector<uint32_t> CompileGLSLShader(const std::string& file_name,
         size_t length = shaderc_result_get_length(result);
         auto bytes = shaderc_result_get_bytes(result);
 
-        data.resize(length / 4);
         auto words = reinterpret_cast<const uint32_t*>(bytes);
-        for (size_t i = 0; i < length / 4; i++) {
-            data[i] = words[i];
-        }
+        data.assign(words, words + length / 4);
 
         break;
     }
@@ -176,17 +395,129 @@ std::vector<uint32_t> CompileGLSLShader(const std::string& file_name,
 
     shaderc_result_release(result);
     shaderc_compile_options_release(options);
-    shaderc_compiler_release(compiler);
+
+    std::vector<std::string> included;
+    std::vector<ShaderCacheDependency> dependencies;
+
+    for (auto& file : include_context.included) {
+        included.push_back(file->path);
+        dependencies.push_back({file->path, file->content_hash});
+    }
+
+    shader_includer.SetDependencies(file_name,
+                                    GetShaderVariant(settings, defines),
+                                    std::move(included));
+
+    if (shader_cache.IsOpen()) {
+        shader_cache.Store(cache_key, data, dependencies);
+    }
 
     return data;
 }
 
+#else
+
+ShaderCompiler::ShaderCompiler() { templates.fill(nullptr); }
+
+ShaderCompiler::~ShaderCompiler() {}
+
+std::vector<uint32_t>
+ShaderCompiler::Compile(const std::string& file_name, const std::string&,
+                        VkShaderStageFlagBits, const std::string&,
+                        const ShaderCompileSettings&,
+                        const std::vector<ShaderDefine>&) const {
+    println("Cannot compile {}, the engine was built without shaderc",
+            file_name);
+    return {};
+}
+
+#endif
+
+std::vector<std::future<std::vector<uint32_t>>>
+ShaderCompiler::CompileBatch(std::vector<ShaderCompileJob> jobs) const {
+    std::vector<std::future<std::vector<uint32_t>>> futures;
+    futures.reserve(jobs.size());
+
+    for (auto& job : jobs) {
+        futures.push_back(
+            thread_pool.Submit([this, job = std::move(job)]() {
+                return Compile(job.file_name, job.code, job.stage,
+                               job.include_path, job.settings, job.defines);
+            }));
+    }
+
+    return futures;
+}
+
+void ShaderCompiler::CompileBatch(
+    std::vector<ShaderCompileJob> jobs,
+    std::function<void(size_t, std::vector<uint32_t>)> on_complete) const {
+    for (size_t i = 0; i < jobs.size(); i++) {
+        thread_pool.Enqueue(
+            [this, i, job = std::move(jobs[i]), on_complete]() {
+                on_complete(i, Compile(job.file_name, job.code, job.stage,
+                                       job.include_path, job.settings,
+                                       job.defines));
+            });
+    }
+}
+
+std::vector<uint32_t> CompileGLSLShader(const std::string& file_name,
+                                        const std::string& code,
+                                        VkShaderStageFlagBits stage,
+                                        const std::string& include_path,
+                                        bool gen_debug) {
+    ShaderCompileSettings settings{};
+    settings.gen_debug = gen_debug;
+
+    return shader_compiler.Compile(file_name, code, stage, include_path,
+                                   settings);
+}
+
+std::optional<VkShaderStageFlagBits>
+GetShaderStageFromPath(const std::filesystem::path& path) {
+    auto extension = path.extension().string();
+
+    if (extension == ".vert") {
+        return VK_SHADER_STAGE_VERTEX_BIT;
+    } else if (extension == ".tesc") {
+        return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+    } else if (extension == ".tese") {
+        return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+    } else if (extension == ".geom") {
+        return VK_SHADER_STAGE_GEOMETRY_BIT;
+    } else if (extension == ".frag") {
+        return VK_SHADER_STAGE_FRAGMENT_BIT;
+    } else if (extension == ".comp") {
+        return VK_SHADER_STAGE_COMPUTE_BIT;
+    } else if (extension == ".rgen") {
+        return VK_SHADER_STAGE_RAYGEN_BIT_KHR;
+    } else if (extension == ".rahit") {
+        return VK_SHADER_STAGE_ANY_HIT_BIT_KHR;
+    } else if (extension == ".rchit") {
+        return VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR;
+    } else if (extension == ".rmiss") {
+        return VK_SHADER_STAGE_MISS_BIT_KHR;
+    } else if (extension == ".rint") {
+        return VK_SHADER_STAGE_INTERSECTION_BIT_KHR;
+    } else if (extension == ".rcall") {
+        return VK_SHADER_STAGE_CALLABLE_BIT_KHR;
+    } else if (extension == ".task") {
+        return VK_SHADER_STAGE_TASK_BIT_EXT;
+    } else if (extension == ".mesh") {
+        return VK_SHADER_STAGE_MESH_BIT_EXT;
+    }
+
+    // Anything else, like .glsl, is only ever included
+    return {};
+}
+
 std::optional<VkShaderModule>
-CreateShaderFromSPIR_V(const std::vector<uint32_t>& spir_v) {
+CreateShaderFromSPIR_V(std::span<const uint32_t> spir_v) {
     VkShaderModuleCreateInfo create_info{};
     create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    create_info.codeSize = spir_v.size() * 4;
-    create_info.pCode = static_cast<const uint32_t*>(spir_v.data());
+    create_info.codeSize = spir_v.size_bytes();
+    create_info.pCode = spir_v.data();
 
     VkShaderModule shader_module;
     if (vkCreateShaderModule(vkb_device.device, &create_info,
@@ -199,4 +530,116 @@ CreateShaderFromSPIR_V(const std::vector<uint32_t>& spir_v) {
     return shader_module;
 }
 
+std::optional<ShaderStage>
+CreateShaderStageFromSPIR_V(std::span<const uint32_t> spir_v) {
+    auto reflection = ReflectSPIR_V(spir_v);
+    if (!reflection) {
+        return {};
+    }
+
+    auto module = CreateShaderFromSPIR_V(spir_v);
+    if (!module) {
+        return {};
+    }
+
+    ShaderStage stage{};
+    stage.stage = reflection->stage;
+    stage.module = module.value();
+    stage.hash = HashSpan(spir_v);
+    stage.entry_point = reflection->entry_point;
+
+    return stage;
+}
+
+void ShaderSpecialization::SetBytes(uint32_t constant_id, const void* value,
+                                    size_t size) {
+    for (auto& entry : entries) {
+        if (entry.constantID != constant_id) {
+            continue;
+        }
+
+        if (entry.size == size) {
+            std::memcpy(data.data() + entry.offset, value, size);
+            return;
+        }
+
+        // The size changed, the old bytes are left unused
+        entry.offset = uint32_t(data.size());
+        entry.size = size;
+        data.resize(data.size() + size);
+        std::memcpy(data.data() + entry.offset, value, size);
+        return;
+    }
+
+    VkSpecializationMapEntry entry{};
+    entry.constantID = constant_id;
+    entry.offset = uint32_t(data.size());
+    entry.size = size;
+
+    data.resize(data.size() + size);
+    std::memcpy(data.data() + entry.offset, value, size);
+
+    entries.push_back(entry);
+}
+
+bool ShaderSpecialization::Validate(const ShaderReflection& reflection) const {
+    bool valid = true;
+
+    for (auto& entry : entries) {
+        auto it = std::find_if(
+            reflection.specialization_constants.begin(),
+            reflection.specialization_constants.end(),
+            [&](auto& constant) {
+                return constant.constant_id == entry.constantID;
+            });
+
+        if (it == reflection.specialization_constants.end()) {
+            println("Shader has no specialization constant {}",
+                    entry.constantID);
+            valid = false;
+        } else if (it->size != entry.size) {
+            println("Specialization constant {} is {} bytes, got {}",
+                    entry.constantID, it->size, entry.size);
+            valid = false;
+        }
+    }
+
+    return valid;
+}
+
+uint64_t ShaderSpecialization::GetHash() const {
+    auto hash = HashValue(entries.size());
+
+    for (auto& entry : entries) {
+        hash = HashValue(entry.constantID, hash);
+        hash = HashBytes(data.data() + entry.offset, entry.size, hash);
+    }
+
+    return hash;
+}
+
+const VkSpecializationInfo* ShaderSpecialization::GetInfo() {
+    if (entries.empty()) {
+        return nullptr;
+    }
+
+    info.mapEntryCount = uint32_t(entries.size());
+    info.pMapEntries = entries.data();
+    info.dataSize = data.size();
+    info.pData = data.data();
+
+    return &info;
+}
+
+VkPipelineShaderStageCreateInfo ShaderStage::GetCreateInfo() {
+    VkPipelineShaderStageCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    create_info.stage = stage;
+    create_info.module = module;
+    create_info.pName = entry_point.c_str();
+    create_info.pSpecializationInfo = specialization.GetInfo();
+
+    return create_info;
+}
+
 } // namespace crow
\ No newline at end of file
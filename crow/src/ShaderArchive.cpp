@@ -0,0 +1,352 @@
+#include <Crow/ShaderArchive.hpp>
+
+#include <Crow/Hash.hpp>
+#include <Crow/Log.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace crow {
+
+namespace {
+
+constexpr uint32_t archive_magic = 0x41535243; // "CRSA"
+constexpr uint32_t archive_version = 1;
+
+// The table of contents follows the header and is sorted by name hash. Names
+// come after it, then the SPIR-V blobs, each starting on a 4 byte boundary
+struct ArchiveHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t names_offset;
+    uint32_t names_size;
+    uint32_t reserved;
+};
+
+struct ArchiveEntry {
+    uint64_t name_hash;
+    uint32_t name_offset;
+    uint32_t name_length;
+    uint32_t offset;
+    uint32_t word_count;
+};
+
+const ArchiveHeader* GetHeader(const std::byte* data) {
+    return reinterpret_cast<const ArchiveHeader*>(data);
+}
+
+const ArchiveEntry* GetEntries(const std::byte* data) {
+    return reinterpret_cast<const ArchiveEntry*>(data +
+                                                 sizeof(ArchiveHeader));
+}
+
+// Everything Find relies on is checked once here so lookups can trust the
+// table of contents
+bool IsValid(const std::byte* data, size_t size) {
+    if (size < sizeof(ArchiveHeader)) {
+        return false;
+    }
+
+    auto header = GetHeader(data);
+    if (header->magic != archive_magic ||
+        header->version != archive_version) {
+        return false;
+    }
+
+    auto entries_end =
+        sizeof(ArchiveHeader) + uint64_t(header->entry_count) *
+                                    sizeof(ArchiveEntry);
+    if (entries_end > size || header->names_offset < entries_end ||
+        uint64_t(header->names_offset) + header->names_size > size) {
+        return false;
+    }
+
+    auto entries = GetEntries(data);
+    for (uint32_t i = 0; i < header->entry_count; i++) {
+        auto& entry = entries[i];
+
+        if (uint64_t(entry.name_offset) + entry.name_length >
+                header->names_size ||
+            entry.offset % 4 != 0 ||
+            uint64_t(entry.offset) + uint64_t(entry.word_count) * 4 > size) {
+            return false;
+        }
+
+        if (i > 0 && entries[i - 1].name_hash > entry.name_hash) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+uint32_t AlignTo4(uint64_t offset) { return uint32_t((offset + 3) & ~3ull); }
+
+} // namespace
+
+ShaderArchive::~ShaderArchive() { Close(); }
+
+#ifdef _WIN32
+
+bool ShaderArchive::Open(const std::filesystem::path& path) {
+    Close();
+
+    auto file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        println("Could not open shader archive {}", path.string());
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+        println("Could not open shader archive {}", path.string());
+        CloseHandle(file);
+        return false;
+    }
+
+    auto mapping =
+        CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        println("Could not map shader archive {}", path.string());
+        CloseHandle(file);
+        return false;
+    }
+
+    auto view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        println("Could not map shader archive {}", path.string());
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    file_handle = file;
+    mapping_handle = mapping;
+    data = static_cast<const std::byte*>(view);
+    size = size_t(file_size.QuadPart);
+
+    if (!IsValid(data, size)) {
+        println("Invalid shader archive {}", path.string());
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+void ShaderArchive::Close() {
+    if (data) {
+        UnmapViewOfFile(data);
+        data = nullptr;
+        size = 0;
+    }
+
+    if (mapping_handle) {
+        CloseHandle(mapping_handle);
+        mapping_handle = nullptr;
+    }
+
+    if (file_handle) {
+        CloseHandle(file_handle);
+        file_handle = nullptr;
+    }
+}
+
+#else
+
+bool ShaderArchive::Open(const std::filesystem::path& path) {
+    Close();
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        println("Could not open shader archive {}", path.string());
+        return false;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+        println("Could not open shader archive {}", path.string());
+        close(fd);
+        return false;
+    }
+
+    auto view = mmap(nullptr, size_t(file_stat.st_size), PROT_READ,
+                     MAP_PRIVATE, fd, 0);
+
+    // The mapping keeps the file alive on its own
+    close(fd);
+
+    if (view == MAP_FAILED) {
+        println("Could not map shader archive {}", path.string());
+        return false;
+    }
+
+    data = static_cast<const std::byte*>(view);
+    size = size_t(file_stat.st_size);
+
+    if (!IsValid(data, size)) {
+        println("Invalid shader archive {}", path.string());
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+void ShaderArchive::Close() {
+    if (data) {
+        munmap(const_cast<std::byte*>(data), size);
+        data = nullptr;
+        size = 0;
+    }
+}
+
+#endif
+
+std::optional<std::span<const uint32_t>>
+ShaderArchive::Find(std::string_view name) const {
+    if (!data) {
+        return {};
+    }
+
+    auto header = GetHeader(data);
+    auto entries = GetEntries(data);
+    auto end = entries + header->entry_count;
+    auto names = reinterpret_cast<const char*>(data + header->names_offset);
+
+    auto hash = HashString(name);
+
+    auto it = std::lower_bound(
+        entries, end, hash,
+        [](const ArchiveEntry& entry, uint64_t hash) {
+            return entry.name_hash < hash;
+        });
+
+    for (; it != end && it->name_hash == hash; it++) {
+        std::string_view entry_name{names + it->name_offset,
+                                    it->name_length};
+        if (entry_name != name) {
+            continue;
+        }
+
+        auto words = reinterpret_cast<const uint32_t*>(data + it->offset);
+        return std::span<const uint32_t>(words, it->word_count);
+    }
+
+    return {};
+}
+
+size_t ShaderArchive::GetEntryCount() const {
+    if (!data) {
+        return 0;
+    }
+
+    return GetHeader(data)->entry_count;
+}
+
+std::vector<std::string_view> ShaderArchive::GetNames() const {
+    if (!data) {
+        return {};
+    }
+
+    auto header = GetHeader(data);
+    auto entries = GetEntries(data);
+    auto names = reinterpret_cast<const char*>(data + header->names_offset);
+
+    std::vector<std::string_view> result;
+    result.reserve(header->entry_count);
+
+    for (uint32_t i = 0; i < header->entry_count; i++) {
+        result.emplace_back(names + entries[i].name_offset,
+                            entries[i].name_length);
+    }
+
+    return result;
+}
+
+bool ShaderArchiveWriter::Add(std::string name, std::vector<uint32_t> spir_v) {
+    for (auto& entry : entries) {
+        if (entry.name == name) {
+            return false;
+        }
+    }
+
+    entries.push_back({std::move(name), std::move(spir_v)});
+    return true;
+}
+
+bool ShaderArchiveWriter::Write(const std::filesystem::path& path) const {
+    std::vector<ArchiveEntry> table(entries.size());
+    std::vector<const Entry*> order(entries.size());
+
+    for (size_t i = 0; i < entries.size(); i++) {
+        order[i] = &entries[i];
+    }
+
+    std::sort(order.begin(), order.end(), [](auto a, auto b) {
+        return HashString(a->name) < HashString(b->name);
+    });
+
+    std::string names;
+    for (size_t i = 0; i < order.size(); i++) {
+        table[i].name_hash = HashString(order[i]->name);
+        table[i].name_offset = uint32_t(names.size());
+        table[i].name_length = uint32_t(order[i]->name.size());
+        table[i].word_count = uint32_t(order[i]->spir_v.size());
+
+        names += order[i]->name;
+    }
+
+    ArchiveHeader header{};
+    header.magic = archive_magic;
+    header.version = archive_version;
+    header.entry_count = uint32_t(table.size());
+    header.names_offset =
+        uint32_t(sizeof(ArchiveHeader) + table.size() * sizeof(ArchiveEntry));
+    header.names_size = uint32_t(names.size());
+
+    auto offset = AlignTo4(uint64_t(header.names_offset) + names.size());
+    for (auto& entry : table) {
+        entry.offset = offset;
+        offset = AlignTo4(uint64_t(offset) + uint64_t(entry.word_count) * 4);
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        println("Could not write shader archive {}", path.string());
+        return false;
+    }
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(table.data()),
+               std::streamsize(table.size() * sizeof(ArchiveEntry)));
+    file.write(names.data(), std::streamsize(names.size()));
+
+    constexpr char padding[4] = {};
+    auto position = uint64_t(header.names_offset) + names.size();
+    file.write(padding, std::streamsize(AlignTo4(position) - position));
+
+    for (auto entry : order) {
+        file.write(reinterpret_cast<const char*>(entry->spir_v.data()),
+                   std::streamsize(entry->spir_v.size() * 4));
+    }
+
+    return bool(file);
+}
+
+} // namespace crow
\ No newline at end of file
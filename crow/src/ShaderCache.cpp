@@ -0,0 +1,350 @@
+#include <Crow/ShaderCache.hpp>
+
+#include <Crow/Hash.hpp>
+#include <Crow/Log.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <format>
+#include <fstream>
+#include <iterator>
+
+// Only the compiler uses the cache, and shipping builds leave it out
+#ifndef CROW_NO_SHADERC
+
+namespace crow {
+
+namespace {
+
+constexpr uint32_t cache_magic = 0x43535243; // "CRSC"
+constexpr uint32_t cache_version = 1;
+
+struct EntryHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t dependency_count;
+    uint32_t word_count;
+};
+
+template <typename T>
+bool ReadValue(std::ifstream& file, T& value) {
+    file.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return bool(file);
+}
+
+template <typename T>
+void WriteValue(std::ofstream& file, const T& value) {
+    file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+std::optional<uint64_t> HashFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return {};
+    }
+
+    std::string contents{std::istreambuf_iterator<char>(file),
+                         std::istreambuf_iterator<char>()};
+    return HashString(contents);
+}
+
+} // namespace
+
+std::filesystem::path ShaderCache::GetEntryPath(uint64_t key) const {
+    return directory / std::format("{:016x}.spv", key);
+}
+
+bool ShaderCache::Open(const std::filesystem::path& directory,
+                       uint64_t max_size) {
+    std::lock_guard lock{mutex};
+
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    if (ec) {
+        println("Could not create shader cache directory {}: {}",
+                directory.string(), ec.message());
+        return false;
+    }
+
+    this->directory = directory;
+    this->max_size = max_size;
+    total_size = 0;
+    use_counter = 0;
+    entries.clear();
+
+    struct Found {
+        uint64_t key;
+        uint64_t size;
+        std::filesystem::file_time_type time;
+    };
+
+    std::vector<Found> found;
+
+    for (auto& file : std::filesystem::directory_iterator(directory, ec)) {
+        if (!file.is_regular_file() || file.path().extension() != ".spv") {
+            continue;
+        }
+
+        auto stem = file.path().stem().string();
+        uint64_t key = 0;
+        auto [ptr, err] =
+            std::from_chars(stem.data(), stem.data() + stem.size(), key, 16);
+        if (err != std::errc() || ptr != stem.data() + stem.size()) {
+            continue;
+        }
+
+        found.push_back({key, file.file_size(), file.last_write_time()});
+    }
+
+    // Entries are touched on every hit, so the modification time gives the
+    // LRU order from previous sessions
+    std::sort(found.begin(), found.end(),
+              [](auto& a, auto& b) { return a.time < b.time; });
+
+    for (auto& entry : found) {
+        entries[entry.key] = {entry.size, use_counter++};
+        total_size += entry.size;
+    }
+
+    Evict();
+
+    println("Opened shader cache {} with {} entries ({} bytes)",
+            directory.string(), entries.size(), total_size);
+
+    return true;
+}
+
+void ShaderCache::Close() {
+    std::lock_guard lock{mutex};
+    directory.clear();
+    entries.clear();
+    total_size = 0;
+}
+
+std::optional<ShaderCacheEntry>
+ShaderCache::Load(uint64_t key, const ShaderCacheDependencyHasher& hasher) {
+    std::filesystem::path path;
+
+    {
+        std::lock_guard lock{mutex};
+
+        if (directory.empty() || !entries.contains(key)) {
+            misses++;
+            return {};
+        }
+
+        path = GetEntryPath(key);
+    }
+
+    std::ifstream file(path, std::ios::binary);
+
+    EntryHeader header;
+    if (!file || !ReadValue(file, header) || header.magic != cache_magic ||
+        header.version != cache_version || header.key != key) {
+        misses++;
+        return {};
+    }
+
+    ShaderCacheEntry entry;
+    entry.dependencies.reserve(header.dependency_count);
+
+    for (uint32_t i = 0; i < header.dependency_count; i++) {
+        uint32_t length;
+        if (!ReadValue(file, length)) {
+            misses++;
+            return {};
+        }
+
+        std::string dependency(length, '\0');
+        file.read(dependency.data(), length);
+
+        uint64_t content_hash;
+        if (!ReadValue(file, content_hash)) {
+            misses++;
+            return {};
+        }
+
+        auto current_hash =
+            hasher ? hasher(dependency) : HashFile(dependency);
+        if (!current_hash || current_hash.value() != content_hash) {
+            misses++;
+            return {};
+        }
+
+        entry.dependencies.push_back({std::move(dependency), content_hash});
+    }
+
+    entry.spir_v.resize(header.word_count);
+    file.read(reinterpret_cast<char*>(entry.spir_v.data()),
+              std::streamsize(entry.spir_v.size() * 4));
+
+    if (!file) {
+        misses++;
+        return {};
+    }
+
+    {
+        std::lock_guard lock{mutex};
+
+        auto it = entries.find(key);
+        if (it != entries.end()) {
+            it->second.last_use = use_counter++;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::last_write_time(
+        path, std::filesystem::file_time_type::clock::now(), ec);
+
+    hits++;
+    return entry;
+}
+
+void ShaderCache::Store(
+    uint64_t key, const std::vector<uint32_t>& spir_v,
+    const std::vector<ShaderCacheDependency>& dependencies) {
+    if (spir_v.empty()) {
+        return;
+    }
+
+    std::filesystem::path store_directory;
+    std::filesystem::path path;
+    std::filesystem::path temp_path;
+
+    // Only the index is guarded, the file is written outside the lock so
+    // other compiles are not held up by disk I/O
+    {
+        std::lock_guard lock{mutex};
+
+        if (directory.empty()) {
+            return;
+        }
+
+        store_directory = directory;
+        path = GetEntryPath(key);
+
+        // Write to a temporary file first so that a crash or a concurrent
+        // reader never sees a partial entry. Each store gets its own, as
+        // the same key can be stored from two threads at once
+        temp_path = path;
+        temp_path += std::format(".{}.tmp", temp_counter++);
+    }
+
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            println("Could not write shader cache entry {}", path.string());
+            return;
+        }
+
+        EntryHeader header{};
+        header.magic = cache_magic;
+        header.version = cache_version;
+        header.key = key;
+        header.dependency_count = uint32_t(dependencies.size());
+        header.word_count = uint32_t(spir_v.size());
+
+        WriteValue(file, header);
+
+        for (auto& dependency : dependencies) {
+            WriteValue(file, uint32_t(dependency.path.size()));
+            file.write(dependency.path.data(),
+                       std::streamsize(dependency.path.size()));
+            WriteValue(file, dependency.content_hash);
+        }
+
+        file.write(reinterpret_cast<const char*>(spir_v.data()),
+                   std::streamsize(spir_v.size() * 4));
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(temp_path, path, ec);
+    if (ec) {
+        println("Could not write shader cache entry {}: {}", path.string(),
+                ec.message());
+        std::filesystem::remove(temp_path, ec);
+        return;
+    }
+
+    auto size = std::filesystem::file_size(path, ec);
+    if (ec) {
+        return;
+    }
+
+    std::lock_guard lock{mutex};
+
+    // Closed or moved while the entry was written
+    if (directory != store_directory) {
+        return;
+    }
+
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+        total_size -= it->second.size;
+    }
+
+    entries[key] = {size, use_counter++};
+    total_size += size;
+
+    Evict();
+}
+
+void ShaderCache::Evict() {
+    if (max_size == 0 || total_size <= max_size) {
+        return;
+    }
+
+    std::vector<std::pair<uint64_t, uint64_t>> order;
+    order.reserve(entries.size());
+    for (auto& [key, entry] : entries) {
+        order.push_back({entry.last_use, key});
+    }
+
+    std::sort(order.begin(), order.end());
+
+    // Evict down to 90% so that a full cache does not evict on every store
+    auto target = max_size - max_size / 10;
+
+    for (auto& [last_use, key] : order) {
+        if (total_size <= target) {
+            break;
+        }
+
+        std::error_code ec;
+        std::filesystem::remove(GetEntryPath(key), ec);
+
+        total_size -= entries[key].size;
+        entries.erase(key);
+        evictions++;
+    }
+}
+
+void ShaderCache::Clear() {
+    std::lock_guard lock{mutex};
+
+    for (auto& [key, entry] : entries) {
+        std::error_code ec;
+        std::filesystem::remove(GetEntryPath(key), ec);
+    }
+
+    entries.clear();
+    total_size = 0;
+}
+
+ShaderCacheStats ShaderCache::GetStats() const {
+    std::lock_guard lock{mutex};
+
+    ShaderCacheStats stats{};
+    stats.hits = hits;
+    stats.misses = misses;
+    stats.evictions = evictions;
+    stats.entry_count = entries.size();
+    stats.total_size = total_size;
+
+    return stats;
+}
+
+} // namespace crow
+
+#endif
\ No newline at end of file
@@ -0,0 +1,353 @@
+#include <Crow/ShaderHotReload.hpp>
+
+#include <Crow/Hash.hpp>
+#include <Crow/Log.hpp>
+#include <Crow/Pipeline.hpp>
+#include <Crow/ShaderInclude.hpp>
+#include <Crow/ThreadPool.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <unordered_set>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// Shipping builds have no compiler to reload shaders with
+#ifndef CROW_NO_SHADERC
+
+namespace crow {
+
+namespace {
+
+constexpr auto watch_interval = std::chrono::milliseconds(100);
+
+} // namespace
+
+ShaderHotReloader::~ShaderHotReloader() { Stop(); }
+
+ShaderWatchHandle ShaderHotReloader::Watch(
+    const std::string& file_name, VkShaderStageFlagBits stage,
+    const std::string& include_path, const ShaderCompileSettings& settings,
+    std::vector<ShaderDefine> defines, std::span<const uint32_t> spir_v,
+    ShaderReloadCallback on_reload) {
+    WatchedShader shader{};
+    shader.file_name = file_name;
+    shader.normalized_name = ShaderIncluder::NormalizePath(file_name);
+    shader.stage = stage;
+    shader.include_path = include_path;
+    shader.settings = settings;
+    shader.defines = std::move(defines);
+    shader.on_reload = std::move(on_reload);
+    shader.hash = HashSpan(spir_v);
+
+    std::lock_guard lock{shaders_mutex};
+
+    auto handle = next_handle++;
+    shaders[handle] = std::move(shader);
+
+    return handle;
+}
+
+void ShaderHotReloader::Unwatch(ShaderWatchHandle handle) {
+    std::lock_guard lock{shaders_mutex};
+    shaders.erase(handle);
+}
+
+void ShaderHotReloader::Start() {
+    if (running) {
+        return;
+    }
+
+    running = true;
+    thread = std::thread([this]() { WatchLoop(); });
+}
+
+void ShaderHotReloader::Stop() {
+    if (!running) {
+        return;
+    }
+
+    running = false;
+    thread.join();
+
+    // Jobs already on the thread pool still create modules, so they have to
+    // finish while the device is alive. Nothing queues new ones after the
+    // watch thread is gone
+    std::unique_lock lock{pending_mutex};
+    idle.wait(lock, [this]() { return in_flight == 0; });
+
+    for (auto& reload : pending) {
+        vkDestroyShaderModule(vkb_device.device, reload.module,
+                              vkb_device.allocation_callbacks);
+    }
+    pending.clear();
+}
+
+std::vector<std::string> ShaderHotReloader::GetWatchedFiles() {
+    std::vector<std::string> files;
+
+    {
+        std::lock_guard lock{shaders_mutex};
+        for (auto& [handle, shader] : shaders) {
+            files.push_back(shader.normalized_name);
+        }
+    }
+
+    auto count = files.size();
+    for (size_t i = 0; i < count; i++) {
+        auto dependencies = shader_includer.GetDependencies(files[i]);
+        files.insert(files.end(), dependencies.begin(), dependencies.end());
+    }
+
+    std::sort(files.begin(), files.end());
+    files.erase(std::unique(files.begin(), files.end()), files.end());
+
+    return files;
+}
+
+void ShaderHotReloader::OnFilesChanged(const std::vector<std::string>& paths) {
+    std::unordered_set<std::string> affected;
+
+    for (auto& path : paths) {
+        shader_includer.Invalidate(path);
+
+        affected.insert(path);
+        for (auto& dependent : shader_includer.GetDependents(path)) {
+            affected.insert(dependent);
+        }
+    }
+
+    std::lock_guard lock{shaders_mutex};
+
+    for (auto& [handle, shader] : shaders) {
+        if (!affected.contains(shader.normalized_name)) {
+            continue;
+        }
+
+        println("Reloading shader {}", shader.file_name);
+
+        shader.sequence++;
+
+        {
+            std::lock_guard lock{pending_mutex};
+            in_flight++;
+        }
+
+        thread_pool.Enqueue([this, handle, shader]() {
+            auto reload = Reload(handle, shader);
+
+            std::lock_guard lock{pending_mutex};
+
+            if (reload) {
+                pending.push_back(std::move(reload.value()));
+            }
+
+            in_flight--;
+            idle.notify_all();
+        });
+    }
+}
+
+std::optional<ShaderHotReloader::PendingReload>
+ShaderHotReloader::Reload(ShaderWatchHandle handle,
+                          const WatchedShader& shader) {
+    // Stop is waiting on this job
+    if (!running) {
+        return {};
+    }
+
+    std::ifstream file(shader.normalized_name, std::ios::binary);
+    if (!file) {
+        println("Could not read shader {}", shader.file_name);
+        return {};
+    }
+
+    std::string code{std::istreambuf_iterator<char>(file),
+                     std::istreambuf_iterator<char>()};
+
+    auto spir_v =
+        shader_compiler.Compile(shader.file_name, code, shader.stage,
+                                shader.include_path, shader.settings,
+                                shader.defines);
+
+    // Keep the old module on failure so a typo does not take the shader away
+    if (spir_v.empty()) {
+        return {};
+    }
+
+    auto module = CreateShaderFromSPIR_V(spir_v);
+    if (!module) {
+        return {};
+    }
+
+    return PendingReload{handle, shader.sequence, module.value(),
+                         std::move(spir_v)};
+}
+
+void ShaderHotReloader::ApplyPendingReloads() {
+    std::vector<PendingReload> reloads;
+
+    {
+        std::lock_guard lock{pending_mutex};
+        if (pending.empty()) {
+            return;
+        }
+        reloads.swap(pending);
+    }
+
+    for (auto& reload : reloads) {
+        ShaderReloadCallback on_reload;
+        uint64_t old_hash = 0;
+
+        {
+            std::lock_guard lock{shaders_mutex};
+            auto it = shaders.find(reload.handle);
+            if (it != shaders.end() &&
+                reload.sequence > it->second.applied) {
+                auto& shader = it->second;
+
+                on_reload = shader.on_reload;
+                old_hash = shader.hash;
+
+                shader.applied = reload.sequence;
+                shader.hash =
+                    HashSpan(std::span<const uint32_t>(reload.spir_v));
+            }
+        }
+
+        if (!on_reload) {
+            vkDestroyShaderModule(vkb_device.device, reload.module,
+                                  vkb_device.allocation_callbacks);
+            continue;
+        }
+
+        // The next GetPipeline with the new module compiles them again
+        pipeline_manager.Invalidate(old_hash);
+
+        on_reload(reload.module, reload.spir_v);
+    }
+}
+
+#ifdef __linux__
+
+void ShaderHotReloader::WatchLoop() {
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        println("Could not initialize inotify, shader hot reload is disabled");
+        return;
+    }
+
+    std::unordered_map<std::string, int> directories;
+    std::unordered_map<int, std::string> watches;
+
+    alignas(inotify_event) char buffer[4096];
+
+    while (running) {
+        // Shaders and their includes change over time, so new directories
+        // are picked up on every iteration
+        for (auto& file : GetWatchedFiles()) {
+            auto directory =
+                std::filesystem::path(file).parent_path().generic_string();
+            if (directories.contains(directory)) {
+                continue;
+            }
+
+            int wd = inotify_add_watch(fd, directory.c_str(),
+                                       IN_CLOSE_WRITE | IN_MOVED_TO |
+                                           IN_CREATE);
+            if (wd < 0) {
+                println("Could not watch shader directory {}", directory);
+            }
+
+            directories[directory] = wd;
+            if (wd >= 0) {
+                watches[wd] = directory;
+            }
+        }
+
+        pollfd poll_fd{};
+        poll_fd.fd = fd;
+        poll_fd.events = POLLIN;
+
+        if (poll(&poll_fd, 1, int(watch_interval.count())) <= 0) {
+            continue;
+        }
+
+        std::vector<std::string> changed;
+
+        while (true) {
+            auto length = read(fd, buffer, sizeof(buffer));
+            if (length <= 0) {
+                break;
+            }
+
+            for (char* ptr = buffer; ptr < buffer + length;) {
+                auto event = reinterpret_cast<const inotify_event*>(ptr);
+                ptr += sizeof(inotify_event) + event->len;
+
+                auto it = watches.find(event->wd);
+                if (it == watches.end() || event->len == 0) {
+                    continue;
+                }
+
+                changed.push_back(ShaderIncluder::NormalizePath(
+                    std::filesystem::path(it->second) / event->name));
+            }
+        }
+
+        if (!changed.empty()) {
+            std::sort(changed.begin(), changed.end());
+            changed.erase(std::unique(changed.begin(), changed.end()),
+                          changed.end());
+
+            OnFilesChanged(changed);
+        }
+    }
+
+    close(fd);
+}
+
+#else
+
+void ShaderHotReloader::WatchLoop() {
+    std::unordered_map<std::string, std::filesystem::file_time_type> times;
+
+    while (running) {
+        std::vector<std::string> changed;
+
+        for (auto& file : GetWatchedFiles()) {
+            std::error_code ec;
+            auto time = std::filesystem::last_write_time(file, ec);
+            if (ec) {
+                continue;
+            }
+
+            auto it = times.find(file);
+            if (it == times.end()) {
+                times[file] = time;
+            } else if (it->second != time) {
+                it->second = time;
+                changed.push_back(file);
+            }
+        }
+
+        if (!changed.empty()) {
+            OnFilesChanged(changed);
+        }
+
+        std::this_thread::sleep_for(watch_interval);
+    }
+}
+
+#endif
+
+} // namespace crow
+
+#endif
\ No newline at end of file
@@ -0,0 +1,174 @@
+#include <Crow/ShaderInclude.hpp>
+
+#include <Crow/Hash.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+namespace crow {
+
+std::string ShaderIncluder::NormalizePath(const std::filesystem::path& path) {
+    std::error_code ec;
+    auto absolute = std::filesystem::absolute(path, ec);
+    if (ec) {
+        return path.lexically_normal().generic_string();
+    }
+
+    return absolute.lexically_normal().generic_string();
+}
+
+void ShaderIncluder::AddIncludeDirectory(
+    const std::filesystem::path& directory) {
+    include_directories.push_back(directory);
+}
+
+void ShaderIncluder::ClearIncludeDirectories() { include_directories.clear(); }
+
+std::shared_ptr<const ShaderIncludeFile>
+ShaderIncluder::LoadFile(const std::filesystem::path& path) {
+    auto normalized = NormalizePath(path);
+
+    {
+        std::shared_lock lock{files_mutex};
+
+        auto it = files.find(normalized);
+        if (it != files.end()) {
+            return it->second;
+        }
+    }
+
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(normalized, ec)) {
+        return nullptr;
+    }
+
+    std::ifstream stream(normalized, std::ios::binary);
+    if (!stream) {
+        return nullptr;
+    }
+
+    auto file = std::make_shared<ShaderIncludeFile>();
+    file->path = normalized;
+    file->contents.assign(std::istreambuf_iterator<char>(stream),
+                          std::istreambuf_iterator<char>());
+    file->content_hash = HashString(file->contents);
+
+    std::unique_lock lock{files_mutex};
+
+    // Another thread may have loaded the same file in the meantime, keep the
+    // first one so that every compile sees the same contents
+    auto [it, inserted] = files.emplace(normalized, std::move(file));
+    return it->second;
+}
+
+std::shared_ptr<const ShaderIncludeFile>
+ShaderIncluder::Resolve(const std::string& requested_source, bool relative,
+                        const std::string& requesting_source,
+                        const std::string& include_path) {
+    std::filesystem::path requested{requested_source};
+
+    if (requested.is_absolute()) {
+        return LoadFile(requested);
+    }
+
+    if (relative) {
+        auto parent = std::filesystem::path(requesting_source).parent_path();
+        auto file = LoadFile(parent / requested);
+        if (file) {
+            return file;
+        }
+    }
+
+    if (!include_path.empty()) {
+        auto file = LoadFile(std::filesystem::path(include_path) / requested);
+        if (file) {
+            return file;
+        }
+    }
+
+    for (auto& directory : include_directories) {
+        auto file = LoadFile(directory / requested);
+        if (file) {
+            return file;
+        }
+    }
+
+    return nullptr;
+}
+
+std::optional<uint64_t>
+ShaderIncluder::GetContentHash(const std::string& path) {
+    auto file = LoadFile(path);
+    if (!file) {
+        return {};
+    }
+
+    return file->content_hash;
+}
+
+void ShaderIncluder::Invalidate(const std::string& path) {
+    std::unique_lock lock{files_mutex};
+    files.erase(NormalizePath(path));
+}
+
+void ShaderIncluder::InvalidateAll() {
+    std::unique_lock lock{files_mutex};
+    files.clear();
+}
+
+void ShaderIncluder::SetDependencies(const std::string& shader,
+                                     uint64_t variant,
+                                     std::vector<std::string> included) {
+    std::sort(included.begin(), included.end());
+    included.erase(std::unique(included.begin(), included.end()),
+                   included.end());
+
+    std::lock_guard lock{dependencies_mutex};
+    dependencies[NormalizePath(shader)][variant] = std::move(included);
+}
+
+std::vector<std::string>
+ShaderIncluder::GetDependencies(const std::string& shader) const {
+    std::lock_guard lock{dependencies_mutex};
+
+    auto it = dependencies.find(NormalizePath(shader));
+    if (it == dependencies.end()) {
+        return {};
+    }
+
+    std::vector<std::string> merged;
+    for (auto& [variant, included] : it->second) {
+        merged.insert(merged.end(), included.begin(), included.end());
+    }
+
+    std::sort(merged.begin(), merged.end());
+    merged.erase(std::unique(merged.begin(), merged.end()), merged.end());
+
+    return merged;
+}
+
+std::vector<std::string>
+ShaderIncluder::GetDependents(const std::string& path) const {
+    auto normalized = NormalizePath(path);
+
+    std::vector<std::string> dependents;
+
+    std::lock_guard lock{dependencies_mutex};
+
+    // The recorded sets are transitive, so a single pass finds shaders that
+    // include the file through other headers as well
+    for (auto& [shader, variants] : dependencies) {
+        for (auto& [variant, included] : variants) {
+            if (std::binary_search(included.begin(), included.end(),
+                                   normalized)) {
+                dependents.push_back(shader);
+                break;
+            }
+        }
+    }
+
+    return dependents;
+}
+
+} // namespace crow
\ No newline at end of file
@@ -0,0 +1,114 @@
+#include <Crow/ShaderModule.hpp>
+
+#include <Crow/DeletionQueue.hpp>
+#include <Crow/Hash.hpp>
+#include <Crow/Log.hpp>
+#include <Crow/Pipeline.hpp>
+#include <Crow/Shader.hpp>
+
+#include <algorithm>
+
+namespace crow {
+
+std::optional<ShaderModuleRef>
+ShaderModuleRegistry::Acquire(std::span<const uint32_t> spir_v) {
+    auto hash = HashSpan(spir_v);
+
+    // A collision may hold the last reference to another module. Dropping it
+    // calls Release, which takes the lock, so these outlive the lock
+    std::vector<ShaderModuleRef> others;
+
+    std::lock_guard lock{mutex};
+
+    auto [begin, end] = modules.equal_range(hash);
+    for (auto it = begin; it != end; it++) {
+        // Expired entries are waiting on Release, which needs the lock
+        auto module = it->second.module.lock();
+        if (!module) {
+            continue;
+        }
+
+        if (!std::ranges::equal(module->spir_v, spir_v)) {
+            others.push_back(std::move(module));
+            continue;
+        }
+
+        shared++;
+        return module;
+    }
+
+    auto handle = CreateShaderFromSPIR_V(spir_v);
+    if (!handle) {
+        return {};
+    }
+
+    auto module = new ShaderModule{handle.value(), hash,
+                                   {spir_v.begin(), spir_v.end()}};
+
+    ShaderModuleRef ref{module, [this](const ShaderModule* module) {
+                            Release(module);
+                            delete module;
+                        }};
+
+    modules.emplace(hash, Entry{ref, module});
+    total_size += spir_v.size_bytes();
+    created++;
+
+    return ref;
+}
+
+void ShaderModuleRegistry::Release(const ShaderModule* module) {
+    {
+        std::lock_guard lock{mutex};
+
+        auto [begin, end] = modules.equal_range(module->hash);
+        auto it = std::find_if(begin, end, [&](const auto& entry) {
+            return entry.second.pointer == module;
+        });
+
+        // Not found means Destroy already took care of it
+        if (it == end) {
+            return;
+        }
+
+        // Pipelines still compiling on other threads may be reading it
+        deletion_queue.Push(module->module);
+
+        total_size -= module->spir_v.size() * 4;
+        modules.erase(it);
+    }
+
+    // Nothing holds this SPIR-V anymore, so neither should the pipelines
+    pipeline_manager.Invalidate(module->hash);
+}
+
+ShaderModuleRegistryStats ShaderModuleRegistry::GetStats() {
+    std::lock_guard lock{mutex};
+
+    ShaderModuleRegistryStats stats{};
+    stats.live_modules = modules.size();
+    stats.total_size = total_size;
+    stats.shared = shared;
+    stats.created = created;
+
+    return stats;
+}
+
+void ShaderModuleRegistry::Destroy() {
+    std::lock_guard lock{mutex};
+
+    if (!modules.empty()) {
+        println("Destroying {} shader modules that are still referenced",
+                modules.size());
+    }
+
+    for (auto& [hash, entry] : modules) {
+        vkDestroyShaderModule(vkb_device.device, entry.pointer->module,
+                              vkb_device.allocation_callbacks);
+    }
+
+    modules.clear();
+    total_size = 0;
+}
+
+} // namespace crow
\ No newline at end of file
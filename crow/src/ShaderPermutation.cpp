@@ -0,0 +1,294 @@
+#include <Crow/ShaderPermutation.hpp>
+
+#include <Crow/Hash.hpp>
+#include <Crow/Log.hpp>
+#include <Crow/ShaderArchive.hpp>
+#include <Crow/ThreadPool.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+namespace crow {
+
+void ShaderVariantManifest::Record(const std::string& file_name,
+                                   VkShaderStageFlagBits stage,
+                                   const std::vector<ShaderDefine>& defines) {
+    auto hash = HashString(file_name);
+    hash = HashValue(stage, hash);
+    for (auto& define : defines) {
+        hash = HashString(define.name, hash);
+        hash = HashString(define.value, hash);
+    }
+
+    std::lock_guard lock{mutex};
+
+    if (recorded.insert(hash).second) {
+        records.push_back({file_name, stage, defines});
+    }
+}
+
+std::vector<ShaderVariantRecord> ShaderVariantManifest::GetRecords() const {
+    std::lock_guard lock{mutex};
+    return records;
+}
+
+bool ShaderVariantManifest::Write(const std::filesystem::path& path) const {
+    std::ofstream file(path, std::ios::trunc);
+    if (!file) {
+        println("Could not write shader variant manifest {}", path.string());
+        return false;
+    }
+
+    std::lock_guard lock{mutex};
+
+    // One variant per line: stage, file name and NAME=VALUE defines, all
+    // separated by tabs
+    for (auto& record : records) {
+        file << uint32_t(record.stage) << '\t' << record.file_name;
+        for (auto& define : record.defines) {
+            file << '\t' << define.name << '=' << define.value;
+        }
+        file << '\n';
+    }
+
+    return bool(file);
+}
+
+std::optional<std::vector<ShaderVariantRecord>>
+ShaderVariantManifest::Read(const std::filesystem::path& path) {
+    std::ifstream file(path);
+    if (!file) {
+        println("Could not read shader variant manifest {}", path.string());
+        return {};
+    }
+
+    std::vector<ShaderVariantRecord> records;
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty()) {
+            continue;
+        }
+
+        std::vector<std::string> fields;
+        std::stringstream stream(line);
+        std::string field;
+        while (std::getline(stream, field, '\t')) {
+            fields.push_back(field);
+        }
+
+        uint32_t stage = 0;
+        auto [ptr, err] = std::from_chars(
+            fields[0].data(), fields[0].data() + fields[0].size(), stage);
+        if (err != std::errc() || fields.size() < 2) {
+            println("Invalid shader variant manifest line: {}", line);
+            continue;
+        }
+
+        ShaderVariantRecord record{};
+        record.stage = VkShaderStageFlagBits(stage);
+        record.file_name = fields[1];
+
+        for (size_t i = 2; i < fields.size(); i++) {
+            auto separator = fields[i].find('=');
+            if (separator == std::string::npos) {
+                record.defines.push_back({fields[i], ""});
+            } else {
+                record.defines.push_back({fields[i].substr(0, separator),
+                                          fields[i].substr(separator + 1)});
+            }
+        }
+
+        records.push_back(std::move(record));
+    }
+
+    return records;
+}
+
+std::string GetShaderVariantName(const std::string& file_name,
+                                 const std::vector<ShaderDefine>& defines) {
+    // Plain shaders are stored by path alone, the '?' keeps variants apart
+    // from them even without defines
+    auto name = file_name + '?';
+
+    for (size_t i = 0; i < defines.size(); i++) {
+        if (i > 0) {
+            name += ';';
+        }
+
+        name += defines[i].name;
+        name += '=';
+        name += defines[i].value;
+    }
+
+    return name;
+}
+
+ShaderPermutation::ShaderPermutation(const std::string& file_name,
+                                     const std::string& code,
+                                     VkShaderStageFlagBits stage,
+                                     const std::string& include_path,
+                                     std::vector<ShaderPermutationAxis> axes,
+                                     const ShaderCompileSettings& settings)
+    : file_name{file_name}, code{code}, stage{stage},
+      include_path{include_path}, settings{settings}, axes{std::move(axes)} {
+    // An axis without values has no default and no valid key
+    std::erase_if(this->axes, [&](const ShaderPermutationAxis& axis) {
+        if (!axis.values.empty()) {
+            return false;
+        }
+
+        println("{} ignores axis {} since it has no values", file_name,
+                axis.name);
+        return true;
+    });
+}
+
+ShaderPermutation::~ShaderPermutation() {
+    std::lock_guard lock{mutex};
+
+    for (auto& [key, variant] : variants) {
+        variant.wait();
+    }
+}
+
+std::optional<ShaderVariantKey>
+ShaderPermutation::GetVariantKey(
+    const std::vector<ShaderDefine>& selection) const {
+    ShaderVariantKey key = 0;
+    ShaderVariantKey stride = 1;
+
+    for (auto& axis : axes) {
+        size_t index = 0;
+
+        for (auto& define : selection) {
+            if (define.name != axis.name) {
+                continue;
+            }
+
+            auto it = std::find(axis.values.begin(), axis.values.end(),
+                                define.value);
+            if (it == axis.values.end()) {
+                println("{} has no value {} for {}", file_name, define.value,
+                        axis.name);
+                return {};
+            }
+
+            index = size_t(it - axis.values.begin());
+        }
+
+        key += index * stride;
+        stride *= axis.values.size();
+    }
+
+    return key;
+}
+
+std::optional<std::vector<ShaderDefine>>
+ShaderPermutation::GetDefines(ShaderVariantKey key) const {
+    if (key >= GetVariantCount()) {
+        println("{} has no variant {}", file_name, key);
+        return {};
+    }
+
+    std::vector<ShaderDefine> defines;
+    defines.reserve(axes.size());
+
+    for (auto& axis : axes) {
+        auto index = key % axis.values.size();
+        key /= axis.values.size();
+
+        defines.push_back({axis.name, axis.values[index]});
+    }
+
+    return defines;
+}
+
+std::shared_future<std::vector<uint32_t>>
+ShaderPermutation::RequestVariant(ShaderVariantKey key) {
+    std::lock_guard lock{mutex};
+
+    auto it = variants.find(key);
+    if (it != variants.end()) {
+        return it->second;
+    }
+
+    auto defines = GetDefines(key);
+    if (!defines) {
+        std::promise<std::vector<uint32_t>> invalid;
+        invalid.set_value({});
+        return invalid.get_future().share();
+    }
+
+    shader_variant_manifest.Record(file_name, stage, defines.value());
+
+    // Shipping builds have no compiler and rely on crowshaderc having built
+    // every variant in the manifest
+    if (shader_archive.IsOpen()) {
+        auto spir_v = shader_archive.Find(
+            GetShaderVariantName(file_name, defines.value()));
+
+        if (spir_v) {
+            std::promise<std::vector<uint32_t>> precompiled;
+            precompiled.set_value({spir_v->begin(), spir_v->end()});
+
+            auto future = precompiled.get_future().share();
+            variants.emplace(key, future);
+
+            return future;
+        }
+    }
+
+    auto future = thread_pool
+                      .Submit([this, defines = std::move(defines.value())]() {
+                          return shader_compiler.Compile(
+                              file_name, code, stage, include_path, settings,
+                              defines);
+                      })
+                      .share();
+
+    variants.emplace(key, future);
+
+    return future;
+}
+
+void ShaderPermutation::Precompile(
+    const std::vector<ShaderVariantRecord>& records) {
+    for (auto& record : records) {
+        if (record.file_name != file_name || record.stage != stage) {
+            continue;
+        }
+
+        auto key = GetVariantKey(record.defines);
+        if (key) {
+            RequestVariant(key.value());
+        }
+    }
+}
+
+uint64_t ShaderPermutation::GetVariantCount() const {
+    uint64_t count = 1;
+    for (auto& axis : axes) {
+        count *= axis.values.size();
+    }
+    return count;
+}
+
+size_t ShaderPermutation::GetCompiledVariantCount() const {
+    std::lock_guard lock{mutex};
+
+    size_t count = 0;
+    for (auto& [key, variant] : variants) {
+        if (variant.wait_for(std::chrono::seconds(0)) ==
+            std::future_status::ready) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+} // namespace crow
\ No newline at end of file
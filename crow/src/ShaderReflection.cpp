@@ -0,0 +1,733 @@
+#include <Crow/ShaderReflection.hpp>
+
+#include <Crow/Log.hpp>
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace crow {
+
+namespace {
+
+constexpr uint32_t spir_v_magic = 0x07230203;
+constexpr size_t spir_v_header_size = 5;
+
+// The subset of the SPIR-V spec that reflection needs
+enum Op : uint32_t {
+    OpName = 5,
+    OpEntryPoint = 15,
+    OpExecutionMode = 16,
+    OpTypeBool = 20,
+    OpTypeInt = 21,
+    OpTypeFloat = 22,
+    OpTypeVector = 23,
+    OpTypeMatrix = 24,
+    OpTypeImage = 25,
+    OpTypeSampler = 26,
+    OpTypeSampledImage = 27,
+    OpTypeArray = 28,
+    OpTypeRuntimeArray = 29,
+    OpTypeStruct = 30,
+    OpTypePointer = 32,
+    OpConstant = 43,
+    OpSpecConstantTrue = 48,
+    OpSpecConstantFalse = 49,
+    OpSpecConstant = 50,
+    OpVariable = 59,
+    OpDecorate = 71,
+    OpMemberDecorate = 72,
+    OpExecutionModeId = 331,
+    OpTypeAccelerationStructureKHR = 5341,
+};
+
+enum Decoration : uint32_t {
+    DecorationSpecId = 1,
+    DecorationBlock = 2,
+    DecorationBufferBlock = 3,
+    DecorationArrayStride = 6,
+    DecorationMatrixStride = 7,
+    DecorationBuiltIn = 11,
+    DecorationLocation = 30,
+    DecorationBinding = 33,
+    DecorationDescriptorSet = 34,
+    DecorationOffset = 35,
+};
+
+enum StorageClass : uint32_t {
+    StorageClassUniformConstant = 0,
+    StorageClassInput = 1,
+    StorageClassUniform = 2,
+    StorageClassPushConstant = 9,
+    StorageClassStorageBuffer = 12,
+};
+
+enum ExecutionMode : uint32_t {
+    ExecutionModeLocalSize = 17,
+    ExecutionModeLocalSizeId = 38,
+};
+
+enum Dim : uint32_t {
+    DimBuffer = 5,
+    DimSubpassData = 6,
+};
+
+struct Type {
+    uint32_t opcode;
+    std::vector<uint32_t> operands;
+};
+
+struct Decorations {
+    std::optional<uint32_t> spec_id;
+    std::optional<uint32_t> set;
+    std::optional<uint32_t> binding;
+    std::optional<uint32_t> location;
+    std::optional<uint32_t> array_stride;
+    bool block = false;
+    bool buffer_block = false;
+    bool built_in = false;
+};
+
+struct MemberDecorations {
+    uint32_t offset = 0;
+    uint32_t matrix_stride = 0;
+};
+
+struct Variable {
+    uint32_t id;
+    uint32_t type;
+    uint32_t storage_class;
+};
+
+struct SpecConstant {
+    uint32_t id;
+    uint32_t type;
+    uint64_t default_value;
+};
+
+struct Module {
+    std::unordered_map<uint32_t, std::string> names;
+    std::unordered_map<uint32_t, Decorations> decorations;
+    std::unordered_map<uint32_t, std::vector<MemberDecorations>> members;
+    std::unordered_map<uint32_t, Type> types;
+    std::unordered_map<uint32_t, uint32_t> constants;
+    std::vector<Variable> variables;
+    std::vector<SpecConstant> spec_constants;
+
+    inline const Type* GetType(uint32_t id) const {
+        auto it = types.find(id);
+        return it == types.end() ? nullptr : &it->second;
+    }
+
+    inline const Decorations* GetDecorations(uint32_t id) const {
+        auto it = decorations.find(id);
+        return it == decorations.end() ? nullptr : &it->second;
+    }
+
+    inline MemberDecorations GetMember(uint32_t id, uint32_t member) const {
+        auto it = members.find(id);
+        if (it == members.end() || member >= it->second.size()) {
+            return {};
+        }
+        return it->second[member];
+    }
+
+    inline uint32_t GetConstant(uint32_t id) const {
+        auto it = constants.find(id);
+        return it == constants.end() ? 0 : it->second;
+    }
+
+    inline std::string GetName(uint32_t id) const {
+        auto it = names.find(id);
+        return it == names.end() ? std::string{} : it->second;
+    }
+};
+
+std::string ReadString(std::span<const uint32_t> words, size_t& word_count) {
+    std::string str;
+
+    for (word_count = 0; word_count < words.size(); word_count++) {
+        auto word = words[word_count];
+        for (int i = 0; i < 4; i++) {
+            char c = char((word >> (i * 8)) & 0xff);
+            if (c == '\0') {
+                word_count++;
+                return str;
+            }
+            str.push_back(c);
+        }
+    }
+
+    return str;
+}
+
+std::optional<VkShaderStageFlagBits> GetStage(uint32_t execution_model) {
+    switch (execution_model) {
+    case 0:
+        return VK_SHADER_STAGE_VERTEX_BIT;
+    case 1:
+        return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+    case 2:
+        return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+    case 3:
+        return VK_SHADER_STAGE_GEOMETRY_BIT;
+    case 4:
+        return VK_SHADER_STAGE_FRAGMENT_BIT;
+    case 5:
+        return VK_SHADER_STAGE_COMPUTE_BIT;
+    case 5313:
+        return VK_SHADER_STAGE_RAYGEN_BIT_KHR;
+    case 5314:
+        return VK_SHADER_STAGE_INTERSECTION_BIT_KHR;
+    case 5315:
+        return VK_SHADER_STAGE_ANY_HIT_BIT_KHR;
+    case 5316:
+        return VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR;
+    case 5317:
+        return VK_SHADER_STAGE_MISS_BIT_KHR;
+    case 5318:
+        return VK_SHADER_STAGE_CALLABLE_BIT_KHR;
+    case 5364:
+        return VK_SHADER_STAGE_TASK_BIT_EXT;
+    case 5365:
+        return VK_SHADER_STAGE_MESH_BIT_EXT;
+    default:
+        return {};
+    }
+}
+
+uint32_t GetTypeSize(const Module& module, uint32_t type_id,
+                     uint32_t matrix_stride = 0) {
+    auto type = module.GetType(type_id);
+    if (!type) {
+        return 0;
+    }
+
+    switch (type->opcode) {
+    case OpTypeBool:
+        return 4;
+
+    case OpTypeInt:
+    case OpTypeFloat:
+        return type->operands[0] / 8;
+
+    case OpTypeVector:
+        return type->operands[1] * GetTypeSize(module, type->operands[0]);
+
+    case OpTypeMatrix:
+        if (matrix_stride != 0) {
+            return type->operands[1] * matrix_stride;
+        }
+        return type->operands[1] * GetTypeSize(module, type->operands[0]);
+
+    case OpTypeArray: {
+        auto length = module.GetConstant(type->operands[1]);
+        auto decorations = module.GetDecorations(type_id);
+        if (decorations && decorations->array_stride) {
+            return length * decorations->array_stride.value();
+        }
+        return length * GetTypeSize(module, type->operands[0], matrix_stride);
+    }
+
+    case OpTypeStruct: {
+        uint32_t size = 0;
+        for (uint32_t i = 0; i < type->operands.size(); i++) {
+            auto member = module.GetMember(type_id, i);
+            auto end = member.offset + GetTypeSize(module, type->operands[i],
+                                                   member.matrix_stride);
+            size = std::max(size, end);
+        }
+        return size;
+    }
+
+    case OpTypePointer:
+        // Physical storage buffer pointers
+        return 8;
+
+    default:
+        return 0;
+    }
+}
+
+VkFormat GetVertexFormat(const Module& module, uint32_t type_id) {
+    auto type = module.GetType(type_id);
+    if (!type) {
+        return VK_FORMAT_UNDEFINED;
+    }
+
+    uint32_t components = 1;
+    if (type->opcode == OpTypeVector) {
+        components = type->operands[1];
+        type = module.GetType(type->operands[0]);
+        if (!type) {
+            return VK_FORMAT_UNDEFINED;
+        }
+    }
+
+    if (components < 1 || components > 4) {
+        return VK_FORMAT_UNDEFINED;
+    }
+
+    if (type->opcode == OpTypeFloat && type->operands[0] == 32) {
+        constexpr VkFormat formats[] = {
+            VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT,
+            VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT};
+        return formats[components - 1];
+    }
+
+    if (type->opcode == OpTypeFloat && type->operands[0] == 64) {
+        constexpr VkFormat formats[] = {
+            VK_FORMAT_R64_SFLOAT, VK_FORMAT_R64G64_SFLOAT,
+            VK_FORMAT_R64G64B64_SFLOAT, VK_FORMAT_R64G64B64A64_SFLOAT};
+        return formats[components - 1];
+    }
+
+    if (type->opcode == OpTypeInt && type->operands[0] == 32) {
+        if (type->operands[1]) {
+            constexpr VkFormat formats[] = {
+                VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT,
+                VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT};
+            return formats[components - 1];
+        }
+
+        constexpr VkFormat formats[] = {
+            VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT,
+            VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT};
+        return formats[components - 1];
+    }
+
+    return VK_FORMAT_UNDEFINED;
+}
+
+std::optional<VkDescriptorType> GetDescriptorType(const Module& module,
+                                                  uint32_t type_id,
+                                                  uint32_t storage_class) {
+    auto type = module.GetType(type_id);
+    if (!type) {
+        return {};
+    }
+
+    switch (type->opcode) {
+    case OpTypeSampler:
+        return VK_DESCRIPTOR_TYPE_SAMPLER;
+
+    case OpTypeSampledImage: {
+        auto image = module.GetType(type->operands[0]);
+        if (image && image->operands[1] == DimBuffer) {
+            return VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+        }
+        return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    }
+
+    case OpTypeImage: {
+        auto dim = type->operands[1];
+        auto sampled = type->operands[5];
+
+        if (dim == DimSubpassData) {
+            return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        }
+
+        if (dim == DimBuffer) {
+            return sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER
+                                : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+        }
+
+        return sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE
+                            : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    }
+
+    case OpTypeAccelerationStructureKHR:
+        return VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+
+    case OpTypeStruct: {
+        if (storage_class == StorageClassStorageBuffer) {
+            return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        }
+
+        auto decorations = module.GetDecorations(type_id);
+        if (decorations && decorations->buffer_block) {
+            return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        }
+
+        return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    }
+
+    default:
+        return {};
+    }
+}
+
+} // namespace
+
+std::optional<ShaderReflection>
+ReflectSPIR_V(std::span<const uint32_t> spir_v) {
+    if (spir_v.size() < spir_v_header_size || spir_v[0] != spir_v_magic) {
+        println("Cannot reflect invalid SPIR-V");
+        return {};
+    }
+
+    Module module;
+    ShaderReflection reflection{};
+
+    std::optional<uint32_t> entry_point_id;
+    std::array<uint32_t, 3> local_size_ids{0, 0, 0};
+
+    size_t offset = spir_v_header_size;
+    while (offset < spir_v.size()) {
+        auto word_count = spir_v[offset] >> 16;
+        auto opcode = spir_v[offset] & 0xffff;
+
+        if (word_count == 0 || offset + word_count > spir_v.size()) {
+            println("Cannot reflect truncated SPIR-V");
+            return {};
+        }
+
+        auto operands = spir_v.subspan(offset + 1, word_count - 1);
+        offset += word_count;
+
+        switch (opcode) {
+        case OpName: {
+            size_t length;
+            module.names[operands[0]] = ReadString(operands.subspan(1), length);
+            break;
+        }
+
+        case OpEntryPoint: {
+            // Only the first entry point is reflected
+            if (entry_point_id) {
+                break;
+            }
+
+            auto stage = GetStage(operands[0]);
+            if (!stage) {
+                println("Cannot reflect unknown execution model {}",
+                        operands[0]);
+                return {};
+            }
+
+            size_t length;
+            reflection.stage = stage.value();
+            entry_point_id = operands[1];
+            reflection.entry_point = ReadString(operands.subspan(2), length);
+            break;
+        }
+
+        case OpExecutionMode:
+        case OpExecutionModeId:
+            if (operands.size() < 5 || operands[0] != entry_point_id) {
+                break;
+            }
+
+            if (operands[1] == ExecutionModeLocalSize) {
+                reflection.workgroup_size = {operands[2], operands[3],
+                                             operands[4]};
+            } else if (operands[1] == ExecutionModeLocalSizeId) {
+                local_size_ids = {operands[2], operands[3], operands[4]};
+            }
+            break;
+
+        case OpTypeBool:
+        case OpTypeInt:
+        case OpTypeFloat:
+        case OpTypeVector:
+        case OpTypeMatrix:
+        case OpTypeImage:
+        case OpTypeSampler:
+        case OpTypeSampledImage:
+        case OpTypeArray:
+        case OpTypeRuntimeArray:
+        case OpTypeStruct:
+        case OpTypePointer:
+        case OpTypeAccelerationStructureKHR:
+            module.types[operands[0]] = {
+                opcode, {operands.begin() + 1, operands.end()}};
+            break;
+
+        case OpConstant:
+        case OpSpecConstant:
+            // Only the low word matters for array lengths and sizes
+            if (operands.size() >= 3) {
+                module.constants[operands[1]] = operands[2];
+            }
+
+            if (opcode == OpSpecConstant && operands.size() >= 3) {
+                uint64_t value = operands[2];
+                if (operands.size() >= 4) {
+                    value |= uint64_t(operands[3]) << 32;
+                }
+
+                module.spec_constants.push_back(
+                    {operands[1], operands[0], value});
+            }
+            break;
+
+        case OpSpecConstantTrue:
+        case OpSpecConstantFalse:
+            module.spec_constants.push_back(
+                {operands[1], operands[0],
+                 uint64_t(opcode == OpSpecConstantTrue)});
+            break;
+
+        case OpVariable:
+            module.variables.push_back({operands[1], operands[0], operands[2]});
+            break;
+
+        case OpDecorate: {
+            auto& decorations = module.decorations[operands[0]];
+            switch (operands[1]) {
+            case DecorationSpecId:
+                decorations.spec_id = operands[2];
+                break;
+            case DecorationBlock:
+                decorations.block = true;
+                break;
+            case DecorationBufferBlock:
+                decorations.buffer_block = true;
+                break;
+            case DecorationArrayStride:
+                decorations.array_stride = operands[2];
+                break;
+            case DecorationBuiltIn:
+                decorations.built_in = true;
+                break;
+            case DecorationLocation:
+                decorations.location = operands[2];
+                break;
+            case DecorationBinding:
+                decorations.binding = operands[2];
+                break;
+            case DecorationDescriptorSet:
+                decorations.set = operands[2];
+                break;
+            }
+            break;
+        }
+
+        case OpMemberDecorate: {
+            auto& members = module.members[operands[0]];
+            if (members.size() <= operands[1]) {
+                members.resize(operands[1] + 1);
+            }
+
+            if (operands[2] == DecorationOffset) {
+                members[operands[1]].offset = operands[3];
+            } else if (operands[2] == DecorationMatrixStride) {
+                members[operands[1]].matrix_stride = operands[3];
+            }
+            break;
+        }
+        }
+    }
+
+    if (!entry_point_id) {
+        println("Cannot reflect SPIR-V without an entry point");
+        return {};
+    }
+
+    if (local_size_ids[0] != 0) {
+        for (size_t i = 0; i < 3; i++) {
+            reflection.workgroup_size[i] =
+                module.GetConstant(local_size_ids[i]);
+        }
+    }
+
+    for (auto& variable : module.variables) {
+        auto pointer = module.GetType(variable.type);
+        if (!pointer || pointer->opcode != OpTypePointer) {
+            continue;
+        }
+
+        auto type_id = pointer->operands[1];
+        auto decorations = module.GetDecorations(variable.id);
+
+        switch (variable.storage_class) {
+        case StorageClassUniformConstant:
+        case StorageClassUniform:
+        case StorageClassStorageBuffer: {
+            if (!decorations || !decorations->binding) {
+                break;
+            }
+
+            uint32_t count = 1;
+            auto type = module.GetType(type_id);
+
+            while (type && (type->opcode == OpTypeArray ||
+                            type->opcode == OpTypeRuntimeArray)) {
+                // Runtime arrays need descriptor indexing to be sized at
+                // allocation time, reflect them as a single descriptor
+                if (type->opcode == OpTypeArray) {
+                    count *= module.GetConstant(type->operands[1]);
+                }
+
+                type_id = type->operands[0];
+                type = module.GetType(type_id);
+            }
+
+            auto descriptor_type =
+                GetDescriptorType(module, type_id, variable.storage_class);
+            if (!descriptor_type) {
+                break;
+            }
+
+            ShaderDescriptorBinding binding{};
+            binding.set = decorations->set.value_or(0);
+            binding.binding = decorations->binding.value();
+            binding.type = descriptor_type.value();
+            binding.count = count;
+            binding.name = module.GetName(variable.id);
+
+            reflection.descriptor_bindings.push_back(std::move(binding));
+            break;
+        }
+
+        case StorageClassPushConstant: {
+            auto type = module.GetType(type_id);
+            if (!type || type->opcode != OpTypeStruct) {
+                break;
+            }
+
+            if (type->operands.empty()) {
+                break;
+            }
+
+            uint32_t begin = UINT32_MAX;
+            for (uint32_t i = 0; i < type->operands.size(); i++) {
+                begin = std::min(begin, module.GetMember(type_id, i).offset);
+            }
+
+            VkPushConstantRange range{};
+            range.stageFlags = reflection.stage;
+            range.offset = begin;
+            range.size = GetTypeSize(module, type_id) - begin;
+
+            reflection.push_constant_range = range;
+            break;
+        }
+
+        case StorageClassInput: {
+            if (reflection.stage != VK_SHADER_STAGE_VERTEX_BIT ||
+                !decorations || decorations->built_in ||
+                !decorations->location) {
+                break;
+            }
+
+            ShaderVertexInput input{};
+            input.location = decorations->location.value();
+            input.format = GetVertexFormat(module, type_id);
+            input.name = module.GetName(variable.id);
+
+            reflection.vertex_inputs.push_back(std::move(input));
+            break;
+        }
+        }
+    }
+
+    for (auto& constant : module.spec_constants) {
+        auto decorations = module.GetDecorations(constant.id);
+        auto type = module.GetType(constant.type);
+
+        // Constants without a SpecId are derived from other constants
+        if (!decorations || !decorations->spec_id || !type) {
+            continue;
+        }
+
+        ShaderSpecializationConstant specialization{};
+        specialization.constant_id = decorations->spec_id.value();
+        specialization.size = GetTypeSize(module, constant.type);
+        specialization.default_value = constant.default_value;
+        specialization.name = module.GetName(constant.id);
+
+        if (type->opcode == OpTypeBool) {
+            specialization.type = ShaderSpecializationType::Bool;
+        } else if (type->opcode == OpTypeFloat) {
+            specialization.type = ShaderSpecializationType::Float;
+        } else if (type->operands[1]) {
+            specialization.type = ShaderSpecializationType::Int;
+        } else {
+            specialization.type = ShaderSpecializationType::UInt;
+        }
+
+        reflection.specialization_constants.push_back(
+            std::move(specialization));
+    }
+
+    std::sort(reflection.specialization_constants.begin(),
+              reflection.specialization_constants.end(), [](auto& a, auto& b) {
+                  return a.constant_id < b.constant_id;
+              });
+
+    std::sort(reflection.descriptor_bindings.begin(),
+              reflection.descriptor_bindings.end(), [](auto& a, auto& b) {
+                  return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+              });
+
+    std::sort(
+        reflection.vertex_inputs.begin(), reflection.vertex_inputs.end(),
+        [](auto& a, auto& b) { return a.location < b.location; });
+
+    return reflection;
+}
+
+PipelineLayoutDescription
+MergeShaderReflections(std::span<const ShaderReflection> stages) {
+    PipelineLayoutDescription description;
+
+    for (auto& stage : stages) {
+        for (auto& binding : stage.descriptor_bindings) {
+            if (description.sets.size() <= binding.set) {
+                description.sets.resize(binding.set + 1);
+            }
+
+            auto& set = description.sets[binding.set];
+            auto it = std::find_if(set.begin(), set.end(), [&](auto& other) {
+                return other.binding == binding.binding;
+            });
+
+            if (it == set.end()) {
+                VkDescriptorSetLayoutBinding layout_binding{};
+                layout_binding.binding = binding.binding;
+                layout_binding.descriptorType = binding.type;
+                layout_binding.descriptorCount = binding.count;
+                layout_binding.stageFlags = stage.stage;
+
+                set.push_back(layout_binding);
+                continue;
+            }
+
+            if (it->descriptorType != binding.type) {
+                println("Descriptor set {} binding {} has different types "
+                        "between stages",
+                        binding.set, binding.binding);
+            }
+
+            it->descriptorCount = std::max(it->descriptorCount, binding.count);
+            it->stageFlags |= stage.stage;
+        }
+
+        if (stage.push_constant_range) {
+            auto range = stage.push_constant_range.value();
+
+            auto it = std::find_if(
+                description.push_constant_ranges.begin(),
+                description.push_constant_ranges.end(), [&](auto& other) {
+                    return other.offset == range.offset &&
+                           other.size == range.size;
+                });
+
+            if (it == description.push_constant_ranges.end()) {
+                description.push_constant_ranges.push_back(range);
+            } else {
+                it->stageFlags |= range.stageFlags;
+            }
+        }
+    }
+
+    for (auto& set : description.sets) {
+        std::sort(set.begin(), set.end(), [](auto& a, auto& b) {
+            return a.binding < b.binding;
+        });
+    }
+
+    return description;
+}
+
+} // namespace crow
\ No newline at end of file
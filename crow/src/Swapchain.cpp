@@ -0,0 +1,281 @@
+#include <Crow/Swapchain.hpp>
+
+#include <Crow/DeletionQueue.hpp>
+#include <Crow/Log.hpp>
+
+#include <utility>
+
+namespace crow {
+
+std::optional<VkRenderPass> SwapchainManager::CreateRenderPass(bool load) {
+    VkAttachmentDescription color_attachment{};
+    color_attachment.format = vkb_swapchain.image_format;
+    color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+
+    color_attachment.loadOp =
+        load ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+    color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+    color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+    // The render graph has moved the image to the attachment layout, a
+    // cleared image can still start from undefined
+    color_attachment.initialLayout =
+        load ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+             : VK_IMAGE_LAYOUT_UNDEFINED;
+    color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    VkAttachmentReference color_attachment_ref{};
+    color_attachment_ref.attachment = 0;
+    color_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &color_attachment_ref;
+
+    VkRenderPassCreateInfo render_pass_info{};
+    render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    render_pass_info.attachmentCount = 1;
+    render_pass_info.pAttachments = &color_attachment;
+    render_pass_info.subpassCount = 1;
+    render_pass_info.pSubpasses = &subpass;
+
+    VkRenderPass render_pass;
+    if (vkCreateRenderPass(vkb_device.device, &render_pass_info,
+                           vkb_device.allocation_callbacks,
+                           &render_pass) != VK_SUCCESS) {
+        println("Could not create swapchain render pass");
+        return {};
+    }
+
+    return render_pass;
+}
+
+bool SwapchainManager::CreateRenderPasses() {
+    auto render_pass = CreateRenderPass(false);
+    auto load_render_pass = CreateRenderPass(true);
+
+    if (!render_pass || !load_render_pass) {
+        if (render_pass) {
+            vkDestroyRenderPass(vkb_device.device, render_pass.value(),
+                                vkb_device.allocation_callbacks);
+        }
+
+        if (load_render_pass) {
+            vkDestroyRenderPass(vkb_device.device, load_render_pass.value(),
+                                vkb_device.allocation_callbacks);
+        }
+
+        return false;
+    }
+
+    vk_render_pass = render_pass.value();
+    vk_load_render_pass = load_render_pass.value();
+    return true;
+}
+
+bool SwapchainManager::CreateImageResources() {
+    auto images_ret = vkb_swapchain.get_images();
+
+    if (!images_ret) {
+        println("Failed to get images from swapchain: {}",
+                images_ret.error().message());
+        return false;
+    }
+
+    vk_images = images_ret.value();
+
+    auto image_views_ret = vkb_swapchain.get_image_views();
+
+    if (!image_views_ret) {
+        println("Failed to get image views from swapchain: {}",
+                image_views_ret.error().message());
+        return false;
+    }
+
+    vk_image_views = image_views_ret.value();
+
+    // Dynamic rendering draws to the image views directly
+    uint32_t framebuffer_count =
+        vk_dynamic_rendering ? 0 : vkb_swapchain.image_count;
+
+    for (uint32_t i = 0; i < framebuffer_count; i++) {
+        VkImageView attachments[] = {vk_image_views[i]};
+
+        VkFramebufferCreateInfo framebuffer_info{};
+        framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+
+        framebuffer_info.renderPass = vk_render_pass;
+        framebuffer_info.attachmentCount = 1;
+        framebuffer_info.pAttachments = attachments;
+        framebuffer_info.width = vkb_swapchain.extent.width;
+        framebuffer_info.height = vkb_swapchain.extent.height;
+        framebuffer_info.layers = 1;
+
+        VkFramebuffer framebuffer;
+
+        if (vkCreateFramebuffer(vkb_device.device, &framebuffer_info,
+                                vkb_device.allocation_callbacks,
+                                &framebuffer) != VK_SUCCESS) {
+            println("Could not create swapchain framebuffer");
+            return false;
+        }
+
+        vk_framebuffers.push_back(framebuffer);
+    }
+
+    // Presentation waits on these, so they are only safe to signal again once
+    // the same image has been acquired again
+    VkSemaphoreCreateInfo semaphore_info{};
+    semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    for (uint32_t i = 0; i < vkb_swapchain.image_count; i++) {
+        VkSemaphore semaphore;
+
+        if (vkCreateSemaphore(vkb_device.device, &semaphore_info,
+                              vkb_device.allocation_callbacks,
+                              &semaphore) != VK_SUCCESS) {
+            println("Could not create swapchain semaphore");
+            return false;
+        }
+
+        vk_render_finished_semaphores.push_back(semaphore);
+    }
+
+    return true;
+}
+
+void SwapchainManager::RetireImageResources() {
+    for (auto& semaphore : vk_render_finished_semaphores) {
+        deletion_queue.Push(semaphore);
+    }
+
+    for (auto& framebuffer : vk_framebuffers) {
+        deletion_queue.Push(framebuffer);
+    }
+
+    for (auto& image_view : vk_image_views) {
+        deletion_queue.Push(image_view);
+    }
+
+    vk_render_finished_semaphores.clear();
+    vk_framebuffers.clear();
+    vk_image_views.clear();
+    vk_images.clear();
+}
+
+bool SwapchainManager::Create(uint32_t min_image_count, uint32_t width,
+                              uint32_t height) {
+    this->min_image_count = min_image_count;
+    this->width = width;
+    this->height = height;
+    out_of_date = false;
+
+    vkb::SwapchainBuilder swapchain_builder{vkb_device};
+
+    auto swapchain_ret = swapchain_builder.use_default_format_selection()
+                             .use_default_image_usage_flags()
+                             .use_default_present_mode_selection()
+                             .set_desired_min_image_count(min_image_count)
+                             .set_desired_extent(width, height)
+                             .build();
+
+    if (!swapchain_ret) {
+        println("Failed to create swapchain: {}",
+                swapchain_ret.error().message());
+        return false;
+    }
+
+    vkb_swapchain = swapchain_ret.value();
+
+    return (vk_dynamic_rendering || CreateRenderPasses()) &&
+           CreateImageResources();
+}
+
+bool SwapchainManager::Recreate() {
+    // Minimized, there is nothing to present to
+    if (IsMinimized()) {
+        return false;
+    }
+
+    vkb::SwapchainBuilder swapchain_builder{vkb_device};
+
+    auto swapchain_ret = swapchain_builder.use_default_format_selection()
+                             .use_default_image_usage_flags()
+                             .use_default_present_mode_selection()
+                             .set_desired_min_image_count(min_image_count)
+                             .set_desired_extent(width, height)
+                             .set_old_swapchain(vkb_swapchain)
+                             .build();
+
+    if (!swapchain_ret) {
+        println("Failed to recreate swapchain: {}",
+                swapchain_ret.error().message());
+        return false;
+    }
+
+    auto old_swapchain = std::exchange(vkb_swapchain, swapchain_ret.value());
+
+    // The old swapchain is retired by the new one, but frames in flight may
+    // still present from it
+    RetireImageResources();
+    deletion_queue.Push([old_swapchain]() {
+        vkb::destroy_swapchain(old_swapchain);
+    });
+
+    // The render pass only depends on the format, which rarely changes
+    bool format_changed =
+        !vk_dynamic_rendering &&
+        old_swapchain.image_format != vkb_swapchain.image_format;
+
+    if (format_changed) {
+        deletion_queue.Push(std::exchange(vk_render_pass, VK_NULL_HANDLE));
+        deletion_queue.Push(
+            std::exchange(vk_load_render_pass, VK_NULL_HANDLE));
+    }
+
+    if ((format_changed && !CreateRenderPasses()) || !CreateImageResources()) {
+        return false;
+    }
+
+    out_of_date = false;
+    return true;
+}
+
+void SwapchainManager::Destroy() {
+    for (auto& semaphore : vk_render_finished_semaphores) {
+        vkDestroySemaphore(vkb_device.device, semaphore,
+                           vkb_device.allocation_callbacks);
+    }
+
+    for (auto& framebuffer : vk_framebuffers) {
+        vkDestroyFramebuffer(vkb_device.device, framebuffer,
+                             vkb_device.allocation_callbacks);
+    }
+
+    if (vk_render_pass != VK_NULL_HANDLE) {
+        vkDestroyRenderPass(vkb_device.device, vk_render_pass,
+                            vkb_device.allocation_callbacks);
+    }
+
+    if (vk_load_render_pass != VK_NULL_HANDLE) {
+        vkDestroyRenderPass(vkb_device.device, vk_load_render_pass,
+                            vkb_device.allocation_callbacks);
+    }
+
+    vkb_swapchain.destroy_image_views(vk_image_views);
+    vkb::destroy_swapchain(vkb_swapchain);
+
+    vk_render_finished_semaphores.clear();
+    vk_framebuffers.clear();
+    vk_image_views.clear();
+    vk_images.clear();
+    vk_render_pass = VK_NULL_HANDLE;
+    vk_load_render_pass = VK_NULL_HANDLE;
+    vkb_swapchain = {};
+}
+
+} // namespace crow
\ No newline at end of file
@@ -0,0 +1,67 @@
+#include <Crow/ThreadPool.hpp>
+
+#include <algorithm>
+
+namespace crow {
+
+ThreadPool::ThreadPool(size_t thread_count) : thread_count{thread_count} {
+    if (this->thread_count == 0) {
+        auto cores = size_t(std::thread::hardware_concurrency());
+        this->thread_count = std::max<size_t>(cores, 2) - 1;
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock{mutex};
+        stopping = true;
+    }
+
+    condition.notify_all();
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::Enqueue(std::function<void()> task) {
+    {
+        std::lock_guard lock{mutex};
+
+        // Threads are started on first use so that a pool which is never
+        // used does not cost anything
+        if (threads.empty()) {
+            threads.reserve(thread_count);
+            for (size_t i = 0; i < thread_count; i++) {
+                threads.emplace_back([this]() { WorkerLoop(); });
+            }
+        }
+
+        tasks.push_back(std::move(task));
+    }
+
+    condition.notify_one();
+}
+
+void ThreadPool::WorkerLoop() {
+    while (true) {
+        std::function<void()> task;
+
+        {
+            std::unique_lock lock{mutex};
+            condition.wait(lock,
+                           [this]() { return stopping || !tasks.empty(); });
+
+            if (tasks.empty()) {
+                return;
+            }
+
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+
+        task();
+    }
+}
+
+} // namespace crow
\ No newline at end of file
@@ -0,0 +1,76 @@
+#include <Crow/Timeline.hpp>
+
+#include <Crow/Log.hpp>
+
+namespace crow {
+
+namespace {
+
+// Loaded from the device since the core names need Vulkan 1.2
+PFN_vkGetSemaphoreCounterValueKHR get_semaphore_counter_value = nullptr;
+PFN_vkWaitSemaphoresKHR wait_semaphores = nullptr;
+
+} // namespace
+
+bool QueueTimeline::Create() {
+    if (!get_semaphore_counter_value) {
+        get_semaphore_counter_value =
+            reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(
+                vkGetDeviceProcAddr(vkb_device.device,
+                                    "vkGetSemaphoreCounterValueKHR"));
+        wait_semaphores = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(
+            vkGetDeviceProcAddr(vkb_device.device, "vkWaitSemaphoresKHR"));
+    }
+
+    if (!get_semaphore_counter_value || !wait_semaphores) {
+        println("Timeline semaphore functions are missing");
+        return false;
+    }
+
+    VkSemaphoreTypeCreateInfo type_info{};
+    type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    type_info.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphore_info{};
+    semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphore_info.pNext = &type_info;
+
+    if (vkCreateSemaphore(vkb_device.device, &semaphore_info,
+                          vkb_device.allocation_callbacks,
+                          &semaphore) != VK_SUCCESS) {
+        println("Could not create timeline semaphore");
+        semaphore = VK_NULL_HANDLE;
+        return false;
+    }
+
+    last_submitted = 0;
+    return true;
+}
+
+void QueueTimeline::Destroy() {
+    if (semaphore != VK_NULL_HANDLE) {
+        vkDestroySemaphore(vkb_device.device, semaphore,
+                           vkb_device.allocation_callbacks);
+        semaphore = VK_NULL_HANDLE;
+    }
+}
+
+uint64_t QueueTimeline::GetCompleted() const {
+    uint64_t value = 0;
+    get_semaphore_counter_value(vkb_device.device, semaphore, &value);
+    return value;
+}
+
+bool QueueTimeline::Wait(uint64_t value, uint64_t timeout) const {
+    VkSemaphoreWaitInfo wait_info{};
+    wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    wait_info.semaphoreCount = 1;
+    wait_info.pSemaphores = &semaphore;
+    wait_info.pValues = &value;
+
+    return wait_semaphores(vkb_device.device, &wait_info, timeout) ==
+           VK_SUCCESS;
+}
+
+} // namespace crow
\ No newline at end of file
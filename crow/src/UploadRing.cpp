@@ -0,0 +1,127 @@
+#include <Crow/UploadRing.hpp>
+
+#include <Crow/Log.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+namespace crow {
+
+namespace {
+
+VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+bool UploadRing::Create(VkDeviceSize capacity) {
+    this->capacity = capacity;
+
+    auto& limits = vkb_device.physical_device.properties.limits;
+    min_alignment = std::max(limits.minUniformBufferOffsetAlignment,
+                             limits.minStorageBufferOffsetAlignment);
+
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                               VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                               VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                               VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+    for (size_t i = 0; i < vk_frames_in_flight; i++) {
+        auto buffer =
+            memory_allocator.CreateBuffer(capacity, usage, MemoryUsage::Upload);
+
+        if (!buffer) {
+            return false;
+        }
+
+        frames.push_back(buffer.value());
+        auto& frame = frames.back();
+
+        VkMemoryPropertyFlags properties;
+        vmaGetAllocationMemoryProperties(memory_allocator.Get(),
+                                         frame.allocation, &properties);
+        coherent = coherent && (properties &
+                                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+    }
+
+    head = 0;
+    flushed = 0;
+    peak = 0;
+
+    return true;
+}
+
+void UploadRing::Destroy() {
+    for (auto& frame : frames) {
+        memory_allocator.DestroyBuffer(frame);
+    }
+
+    frames.clear();
+    capacity = 0;
+    coherent = true;
+}
+
+void UploadRing::ResetFrame() {
+    peak = std::max(peak, head.load());
+
+    head = 0;
+    flushed = 0;
+}
+
+void UploadRing::Flush() {
+    if (frames.empty()) {
+        return;
+    }
+
+    VkDeviceSize end = head;
+
+    if (!coherent && end > flushed) {
+        vmaFlushAllocation(memory_allocator.Get(),
+                           frames[vk_frame_index].allocation, flushed,
+                           end - flushed);
+    }
+
+    flushed = end;
+}
+
+std::optional<UploadAllocation> UploadRing::Allocate(VkDeviceSize size,
+                                                     VkDeviceSize alignment) {
+    // Alignments like a 12 byte texel block are not powers of two, so the
+    // offset has to be a multiple of both
+    alignment = std::lcm(std::max(alignment, VkDeviceSize(1)), min_alignment);
+
+    VkDeviceSize offset = head.load(std::memory_order_relaxed);
+    VkDeviceSize aligned;
+
+    do {
+        aligned = AlignUp(offset, alignment);
+
+        if (aligned + size > capacity) {
+            println("Upload ring is out of space, {} of {} bytes used", offset,
+                    capacity);
+            return {};
+        }
+    } while (!head.compare_exchange_weak(offset, aligned + size,
+                                         std::memory_order_relaxed));
+
+    auto& frame = frames[vk_frame_index];
+    return UploadAllocation{frame.buffer, uint32_t(aligned), size,
+                            static_cast<std::byte*>(frame.data) + aligned};
+}
+
+std::optional<UploadAllocation>
+UploadRing::Upload(const void* data, VkDeviceSize size,
+                   VkDeviceSize alignment) {
+    auto allocation = Allocate(size, alignment);
+
+    if (allocation) {
+        std::memcpy(allocation->data, data, size);
+    }
+
+    return allocation;
+}
+
+} // namespace crow
\ No newline at end of file
@@ -0,0 +1,447 @@
+#include <Crow/Uploader.hpp>
+
+#include <Crow/Log.hpp>
+#include <Crow/Timeline.hpp>
+
+#include <cstring>
+#include <utility>
+
+namespace crow {
+
+namespace {
+
+// Batches this large are submitted right away, so that big assets start
+// copying before the frame ends
+constexpr VkDeviceSize submit_size = 32 * 1024 * 1024;
+
+uint32_t GetQueueFamily(UploadQueue queue) {
+    switch (queue) {
+    case UploadQueue::Graphics:
+        return vkb_device.get_queue_index(vkb::QueueType::graphics).value();
+    case UploadQueue::Compute:
+        return vk_compute_queue_family;
+    }
+
+    return VK_QUEUE_FAMILY_IGNORED;
+}
+
+} // namespace
+
+std::optional<Buffer> Uploader::Stage(const void* data, VkDeviceSize size) {
+    auto staging = memory_allocator.CreateBuffer(
+        size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, MemoryUsage::Staging);
+
+    if (!staging) {
+        return {};
+    }
+
+    std::memcpy(staging->data, data, size);
+    vmaFlushAllocation(memory_allocator.Get(), staging->allocation, 0,
+                       VK_WHOLE_SIZE);
+
+    return staging;
+}
+
+void Uploader::RecordAcquires(VkCommandBuffer cmd, const Acquires& acquires) {
+    if (acquires.buffers.empty() && acquires.images.empty()) {
+        return;
+    }
+
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr,
+                         uint32_t(acquires.buffers.size()),
+                         acquires.buffers.data(),
+                         uint32_t(acquires.images.size()),
+                         acquires.images.data());
+}
+
+bool Uploader::Create() {
+    VkCommandPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+                      VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    pool_info.queueFamilyIndex = vk_transfer_queue_family;
+
+    if (vkCreateCommandPool(vkb_device.device, &pool_info,
+                            vkb_device.allocation_callbacks,
+                            &cmd_pool) != VK_SUCCESS) {
+        println("Could not create transfer command pool");
+        cmd_pool = VK_NULL_HANDLE;
+        return false;
+    }
+
+    last_submitted = 0;
+    last_acquired = 0;
+
+    return true;
+}
+
+void Uploader::Destroy() {
+    if (recording) {
+        FreeBatch(recording.value());
+        recording.reset();
+    }
+
+    for (auto& batch : in_flight) {
+        FreeBatch(batch);
+    }
+
+    in_flight.clear();
+    compute_pending = {};
+    acquiring.clear();
+
+    for (auto fence : free_fences) {
+        vkDestroyFence(vkb_device.device, fence,
+                       vkb_device.allocation_callbacks);
+    }
+
+    free_fences.clear();
+    free_cmds.clear();
+
+    if (cmd_pool != VK_NULL_HANDLE) {
+        vkDestroyCommandPool(vkb_device.device, cmd_pool,
+                             vkb_device.allocation_callbacks);
+        cmd_pool = VK_NULL_HANDLE;
+    }
+}
+
+bool Uploader::BeginBatch() {
+    if (recording) {
+        return true;
+    }
+
+    Batch batch{};
+
+    if (!free_cmds.empty()) {
+        batch.cmd = free_cmds.back();
+        free_cmds.pop_back();
+    } else {
+        VkCommandBufferAllocateInfo alloc_info{};
+        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.commandPool = cmd_pool;
+        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        alloc_info.commandBufferCount = 1;
+
+        if (vkAllocateCommandBuffers(vkb_device.device, &alloc_info,
+                                     &batch.cmd) != VK_SUCCESS) {
+            println("Could not allocate transfer command buffer");
+            return false;
+        }
+    }
+
+    if (!vk_timeline_semaphores && !free_fences.empty()) {
+        batch.fence = free_fences.back();
+        free_fences.pop_back();
+    } else if (!vk_timeline_semaphores) {
+        VkFenceCreateInfo fence_info{};
+        fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+        if (vkCreateFence(vkb_device.device, &fence_info,
+                          vkb_device.allocation_callbacks,
+                          &batch.fence) != VK_SUCCESS) {
+            println("Could not create transfer fence");
+            free_cmds.push_back(batch.cmd);
+            return false;
+        }
+    }
+
+    vkResetCommandBuffer(batch.cmd, 0);
+
+    VkCommandBufferBeginInfo begin_info{};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkBeginCommandBuffer(batch.cmd, &begin_info);
+
+    recording = std::move(batch);
+    return true;
+}
+
+void Uploader::AddToBatch(const Buffer& staging, UploadCallback callback) {
+    auto& batch = recording.value();
+
+    batch.staging.push_back(staging);
+    batch.staged_size += staging.size;
+
+    if (callback) {
+        batch.callbacks.push_back(std::move(callback));
+    }
+
+    if (batch.staged_size >= submit_size) {
+        SubmitBatch();
+    }
+}
+
+std::optional<uint64_t> Uploader::SubmitBatch() {
+    if (!recording) {
+        return {};
+    }
+
+    auto batch = std::move(recording.value());
+    recording.reset();
+
+    // Releases ownership to the queues that use the resources, the matching
+    // acquires are recorded there once the batch is done
+    vkCmdPipelineBarrier(batch.cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+                         uint32_t(batch.releases.buffers.size()),
+                         batch.releases.buffers.data(),
+                         uint32_t(batch.releases.images.size()),
+                         batch.releases.images.data());
+
+    vkEndCommandBuffer(batch.cmd);
+
+    VkSubmitInfo submit_info{};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &batch.cmd;
+
+    if (vk_timeline_semaphores) {
+        batch.value = transfer_timeline.Next();
+
+        auto signal_semaphore = transfer_timeline.Get();
+
+        VkTimelineSemaphoreSubmitInfo timeline_info{};
+        timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timeline_info.signalSemaphoreValueCount = 1;
+        timeline_info.pSignalSemaphoreValues = &batch.value;
+
+        submit_info.pNext = &timeline_info;
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores = &signal_semaphore;
+
+        vkQueueSubmit(vk_transfer_queue, 1, &submit_info, VK_NULL_HANDLE);
+    } else {
+        batch.value = last_submitted + 1;
+
+        vkQueueSubmit(vk_transfer_queue, 1, &submit_info, batch.fence);
+    }
+
+    last_submitted = batch.value;
+    in_flight.push_back(std::move(batch));
+
+    return last_submitted;
+}
+
+bool Uploader::IsBatchDone(const Batch& batch) const {
+    if (vk_timeline_semaphores) {
+        return transfer_timeline.IsComplete(batch.value);
+    }
+
+    return vkGetFenceStatus(vkb_device.device, batch.fence) == VK_SUCCESS;
+}
+
+void Uploader::FreeBatch(Batch& batch) {
+    // The transfer queue is the only one reading staging memory
+    for (auto& staging : batch.staging) {
+        memory_allocator.DestroyBuffer(staging);
+    }
+
+    batch.staging.clear();
+
+    free_cmds.push_back(batch.cmd);
+
+    if (batch.fence != VK_NULL_HANDLE) {
+        vkResetFences(vkb_device.device, 1, &batch.fence);
+        free_fences.push_back(batch.fence);
+    }
+}
+
+std::optional<uint64_t>
+Uploader::UploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data,
+                       VkDeviceSize size, UploadQueue queue,
+                       UploadCallback callback) {
+    // Copied outside the lock, loading threads only contend on recording
+    auto staging = Stage(data, size);
+
+    if (!staging) {
+        return {};
+    }
+
+    std::lock_guard lock{mutex};
+
+    if (!BeginBatch()) {
+        memory_allocator.DestroyBuffer(staging.value());
+        return {};
+    }
+
+    auto& batch = recording.value();
+
+    VkBufferCopy region{};
+    region.dstOffset = offset;
+    region.size = size;
+
+    vkCmdCopyBuffer(batch.cmd, staging->buffer, buffer, 1, &region);
+
+    // The transfer queue family is dedicated, so it always differs from the
+    // one the buffer is used on. The buffer is unused until the upload is
+    // done, so there is no earlier owner to release it from
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.srcQueueFamilyIndex = vk_transfer_queue_family;
+    barrier.dstQueueFamilyIndex = GetQueueFamily(queue);
+    barrier.buffer = buffer;
+    barrier.offset = offset;
+    barrier.size = size;
+
+    batch.releases.buffers.push_back(barrier);
+
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+
+    if (queue == UploadQueue::Graphics) {
+        batch.graphics_acquires.buffers.push_back(barrier);
+    } else {
+        batch.compute_acquires.buffers.push_back(barrier);
+    }
+
+    auto value = last_submitted + 1;
+    AddToBatch(staging.value(), std::move(callback));
+
+    return value;
+}
+
+std::optional<uint64_t>
+Uploader::UploadImage(VkImage image, VkImageAspectFlags aspect,
+                      VkExtent3D extent, const void* data, VkDeviceSize size,
+                      VkImageLayout layout, UploadQueue queue,
+                      UploadCallback callback) {
+    // Copies and the ownership transfer below only handle one aspect
+    if (aspect == 0 || (aspect & (aspect - 1)) != 0) {
+        println("Images are uploaded one aspect at a time");
+        return {};
+    }
+
+    auto staging = Stage(data, size);
+
+    if (!staging) {
+        return {};
+    }
+
+    std::lock_guard lock{mutex};
+
+    if (!BeginBatch()) {
+        memory_allocator.DestroyBuffer(staging.value());
+        return {};
+    }
+
+    auto& batch = recording.value();
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = {aspect, 0, 1, 0, 1};
+
+    vkCmdPipelineBarrier(batch.cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                         nullptr, 1, &barrier);
+
+    VkBufferImageCopy region{};
+    region.imageSubresource = {aspect, 0, 0, 1};
+    region.imageExtent = extent;
+
+    vkCmdCopyBufferToImage(batch.cmd, staging->buffer, image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    // The layout change happens as part of the ownership transfer
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = layout;
+    barrier.srcQueueFamilyIndex = vk_transfer_queue_family;
+    barrier.dstQueueFamilyIndex = GetQueueFamily(queue);
+
+    batch.releases.images.push_back(barrier);
+
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+
+    if (queue == UploadQueue::Graphics) {
+        batch.graphics_acquires.images.push_back(barrier);
+    } else {
+        batch.compute_acquires.images.push_back(barrier);
+    }
+
+    auto value = last_submitted + 1;
+    AddToBatch(staging.value(), std::move(callback));
+
+    return value;
+}
+
+std::optional<uint64_t> Uploader::Submit() {
+    std::lock_guard lock{mutex};
+    return SubmitBatch();
+}
+
+void Uploader::Update(VkCommandBuffer cmd) {
+    Acquires graphics_acquires;
+    std::vector<UploadCallback> callbacks;
+
+    {
+        std::lock_guard lock{mutex};
+
+        // The command buffers these were acquired in went out with the last
+        // frame, so the queues that use them own them now
+        while (!acquiring.empty() && acquiring.front().compute_recorded) {
+            for (auto& callback : acquiring.front().callbacks) {
+                callbacks.push_back(std::move(callback));
+            }
+
+            last_acquired = acquiring.front().value;
+            acquiring.pop_front();
+        }
+
+        while (!in_flight.empty() && IsBatchDone(in_flight.front())) {
+            auto& batch = in_flight.front();
+
+            auto append = [](Acquires& to, const Acquires& from) {
+                to.buffers.insert(to.buffers.end(), from.buffers.begin(),
+                                  from.buffers.end());
+                to.images.insert(to.images.end(), from.images.begin(),
+                                 from.images.end());
+            };
+
+            append(graphics_acquires, batch.graphics_acquires);
+            append(compute_pending, batch.compute_acquires);
+
+            bool compute = !batch.compute_acquires.buffers.empty() ||
+                           !batch.compute_acquires.images.empty();
+            acquiring.push_back(
+                {batch.value, !compute, std::move(batch.callbacks)});
+
+            FreeBatch(batch);
+            in_flight.pop_front();
+        }
+    }
+
+    RecordAcquires(cmd, graphics_acquires);
+
+    // Outside the lock so that a callback may upload more
+    for (auto& callback : callbacks) {
+        callback();
+    }
+}
+
+void Uploader::RecordComputeAcquires(VkCommandBuffer cmd) {
+    Acquires acquires;
+
+    {
+        std::lock_guard lock{mutex};
+        acquires = std::exchange(compute_pending, {});
+
+        // Every batch waiting on compute had its acquires pending
+        for (auto& batch : acquiring) {
+            batch.compute_recorded = true;
+        }
+    }
+
+    RecordAcquires(cmd, acquires);
+}
+
+} // namespace crow
\ No newline at end of file
@@ -1,7 +1,21 @@
 #include <Crow/Window.hpp>
 
+#include <Crow/Allocator.hpp>
+#include <Crow/CommandRecorder.hpp>
+#include <Crow/DeletionQueue.hpp>
 #include <Crow/Log.hpp>
-
+#include <Crow/Pipeline.hpp>
+#include <Crow/PipelineCache.hpp>
+#include <Crow/PipelineLayout.hpp>
+#include <Crow/RenderGraph.hpp>
+#include <Crow/ShaderHotReload.hpp>
+#include <Crow/ShaderModule.hpp>
+#include <Crow/Swapchain.hpp>
+#include <Crow/Timeline.hpp>
+#include <Crow/UploadRing.hpp>
+#include <Crow/Uploader.hpp>
+
+#include <algorithm>
 #include <cstdlib>
 
 struct GLFWLifetime {
@@ -24,16 +38,31 @@ GLFWLifetime glfw_lifetime;
 
 namespace crow {
 
+namespace {
+
+constexpr auto pipeline_cache_path = "cache/pipelines.bin";
+
+// Per frame in flight
+constexpr VkDeviceSize upload_ring_size = 4 * 1024 * 1024;
+
+} // namespace
+
 Window::Window(const std::string& title, size_t width, size_t height,
-               bool fullscreen)
+               bool fullscreen, size_t frames_in_flight,
+               uint32_t swapchain_images)
     : title{title}, width{width}, height{height}, fullscreen{fullscreen} {
 
+    vk_frames_in_flight = std::max(frames_in_flight, size_t(1));
+    vk_frame_index = 0;
+
     {
         uint32_t count;
         const char** extentions = glfwGetRequiredInstanceExtensions(&count);
         vkb::InstanceBuilder builder;
+        // The memory allocator relies on 1.1
         builder.set_engine_name("CrowEngine")
             .set_app_name(title.c_str())
+            .require_api_version(1, 1, 0)
 #ifdef CROW_DEBUG
             .request_validation_layers()
 #endif
@@ -79,7 +108,16 @@ Window::Window(const std::string& title, size_t width, size_t height,
         glfwDestroyWindow(window);
         window = nullptr;
 
-        vkb::destroy_swapchain(vkb_swapchain);
+        pipeline_cache.Destroy();
+
+        uploader.Destroy();
+        upload_ring.Destroy();
+        memory_allocator.Destroy();
+
+        transfer_timeline.Destroy();
+        compute_timeline.Destroy();
+        graphics_timeline.Destroy();
+        swapchain_manager.Destroy();
         vkb::destroy_surface(vkb_instance, vk_surface);
         vkb::destroy_device(vkb_device);
         vkb::destroy_instance(vkb_instance);
@@ -114,6 +152,56 @@ Window::Window(const std::string& title, size_t width, size_t height,
         phys.enable_extension_if_present(VK_KHR_SPIRV_1_4_EXTENSION_NAME);
         phys.enable_extension_if_present(VK_EXT_MESH_SHADER_EXTENSION_NAME);
 
+        VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT gpl_features{};
+        gpl_features.sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+        gpl_features.graphicsPipelineLibrary = VK_TRUE;
+
+        vk_graphics_pipeline_library =
+            phys.enable_extension_if_present(
+                VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) &&
+            phys.enable_extension_if_present(
+                VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME) &&
+            phys.enable_extension_features_if_present(gpl_features);
+
+        VkPhysicalDeviceTimelineSemaphoreFeatures timeline_features{};
+        timeline_features.sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+        timeline_features.timelineSemaphore = VK_TRUE;
+
+        vk_timeline_semaphores =
+            phys.enable_extension_if_present(
+                VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME) &&
+            phys.enable_extension_features_if_present(timeline_features);
+
+        VkPhysicalDeviceSynchronization2Features sync2_features{};
+        sync2_features.sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES;
+        sync2_features.synchronization2 = VK_TRUE;
+
+        vk_synchronization2 =
+            phys.enable_extension_if_present(
+                VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME) &&
+            phys.enable_extension_features_if_present(sync2_features);
+
+        VkPhysicalDeviceDynamicRenderingFeatures dynamic_rendering_features{};
+        dynamic_rendering_features.sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
+        dynamic_rendering_features.dynamicRendering = VK_TRUE;
+
+        vk_memory_budget = phys.enable_extension_if_present(
+            VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+        // Before 1.3 the extension requires the two it was built on, which
+        // are only enabled together with it
+        vk_dynamic_rendering =
+            phys.enable_extensions_if_present(
+                {VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME,
+                 VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME,
+                 VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME}) &&
+            phys.enable_extension_features_if_present(
+                dynamic_rendering_features);
+
         vkb::DeviceBuilder device_builder{phys};
         auto dev_ret = device_builder.build();
 
@@ -127,6 +215,13 @@ Window::Window(const std::string& title, size_t width, size_t height,
         vkb_device = dev_ret.value();
     }
 
+    if (!memory_allocator.Create() || !upload_ring.Create(upload_ring_size)) {
+        DestroyWindow();
+        return;
+    }
+
+    pipeline_cache.Load(pipeline_cache_path);
+
     {
         auto graphics_queue_ret =
             vkb_device.get_queue(vkb::QueueType::graphics);
@@ -139,16 +234,22 @@ Window::Window(const std::string& title, size_t width, size_t height,
 
         vk_graphics_queue = graphics_queue_ret.value();
 
+        // Compute only overlaps graphics on a family of its own, otherwise
+        // it shares the graphics queue
         auto compute_queue_ret = vkb_device.get_queue(vkb::QueueType::compute);
-        if (!compute_queue_ret) {
-            println("Failed to get compute queue: {}",
-                    compute_queue_ret.error().message());
-            DestroyWindow();
-            return;
+        auto compute_family_ret =
+            vkb_device.get_queue_index(vkb::QueueType::compute);
+        if (compute_queue_ret && compute_family_ret) {
+            vk_compute_queue = compute_queue_ret.value();
+            vk_compute_queue_family = compute_family_ret.value();
+            vk_async_compute = true;
+        } else {
+            vk_compute_queue = vk_graphics_queue;
+            vk_compute_queue_family =
+                vkb_device.get_queue_index(vkb::QueueType::graphics).value();
+            vk_async_compute = false;
         }
 
-        vk_compute_queue = compute_queue_ret.value();
-
         auto present_queue_ret = vkb_device.get_queue(vkb::QueueType::present);
         if (!present_queue_ret) {
             println("Failed to get present queue: {}",
@@ -169,110 +270,25 @@ Window::Window(const std::string& title, size_t width, size_t height,
         }
 
         vk_transfer_queue = transfer_queue_ret.value();
+        vk_transfer_queue_family =
+            vkb_device.get_queue_index(vkb::QueueType::transfer).value();
     }
 
     {
-        vkb::SwapchainBuilder swapchain_builder{vkb_device};
-
-        auto swapchain_ret = swapchain_builder.use_default_format_selection()
-                                 .use_default_image_usage_flags()
-                                 .use_default_present_mode_selection()
-                                 .build();
-
-        if (!swapchain_ret) {
-            println("Failed to create swapchain: {}",
-                    swapchain_ret.error().message());
-            DestroyWindow();
-            return;
-        }
-
-        vkb_swapchain = swapchain_ret.value();
-    }
-
-    {
-        auto image_views_ret = vkb_swapchain.get_image_views();
+        int framebuffer_width, framebuffer_height;
+        glfwGetFramebufferSize(window, &framebuffer_width, &framebuffer_height);
 
-        if (!image_views_ret) {
-            println("Failed to get image views from swapchain: {}",
-                    image_views_ret.error().message());
+        if (!swapchain_manager.Create(swapchain_images,
+                                      uint32_t(framebuffer_width),
+                                      uint32_t(framebuffer_height))) {
             DestroyWindow();
             return;
         }
 
-        vk_image_views = image_views_ret.value();
-    }
-
-    {
-        for (uint32_t i = 0; i < vkb_swapchain.image_count; i++) {
-            VkAttachmentDescription color_attachment{};
-            color_attachment.format = vkb_swapchain.image_format;
-            color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
-
-            color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-            color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-
-            color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-            color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
-
-            color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-            VkAttachmentReference color_attachment_ref{};
-            color_attachment_ref.attachment = 0;
-            color_attachment_ref.layout =
-                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-            VkSubpassDescription subpass{};
-            subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-
-            subpass.colorAttachmentCount = 1;
-            subpass.pColorAttachments = &color_attachment_ref;
-
-            VkRenderPass render_pass;
-
-            VkRenderPassCreateInfo render_pass_info{};
-            render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-            render_pass_info.attachmentCount = 1;
-            render_pass_info.pAttachments = &color_attachment;
-            render_pass_info.subpassCount = 1;
-            render_pass_info.pSubpasses = &subpass;
-
-            if (vkCreateRenderPass(vkb_device.device, &render_pass_info,
-                                   vkb_device.allocation_callbacks,
-                                   &render_pass) != VK_SUCCESS) {
-                println("Could not create swapchain render pass");
-                DestroyWindow();
-                return;
-            }
-
-            vk_render_passes.push_back(render_pass);
-        }
-    }
-
-    for (uint32_t i = 0; i < vkb_swapchain.image_count; i++) {
-        VkImageView attachments[] = {vk_image_views[i]};
-
-        VkFramebufferCreateInfo framebuffer_info{};
-        framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-
-        framebuffer_info.renderPass = vk_render_passes[i];
-        framebuffer_info.attachmentCount = 1;
-        framebuffer_info.pAttachments = attachments;
-        framebuffer_info.width = vkb_swapchain.extent.width;
-        framebuffer_info.height = vkb_swapchain.extent.height;
-        framebuffer_info.layers = 1;
-
-        VkFramebuffer framebuffer;
-
-        if (vkCreateFramebuffer(vkb_device.device, &framebuffer_info,
-                                vkb_device.allocation_callbacks,
-                                &framebuffer) != VK_SUCCESS) {
-            println("Could not create swapchain framebuffer");
-            DestroyWindow();
-            return;
-        }
-
-        vk_framebuffers.push_back(framebuffer);
+        glfwSetFramebufferSizeCallback(
+            window, [](GLFWwindow*, int width, int height) {
+                swapchain_manager.Resize(uint32_t(width), uint32_t(height));
+            });
     }
 
     {
@@ -299,8 +315,7 @@ Window::Window(const std::string& title, size_t width, size_t height,
 
         compute_pool_info.flags =
             VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-        compute_pool_info.queueFamilyIndex =
-            vkb_device.get_queue_index(vkb::QueueType::compute).value();
+        compute_pool_info.queueFamilyIndex = vk_compute_queue_family;
 
         if (vkCreateCommandPool(vkb_device.device, &compute_pool_info,
                                 vkb_device.allocation_callbacks,
@@ -316,9 +331,9 @@ Window::Window(const std::string& title, size_t width, size_t height,
         alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
         alloc_info.commandPool = vk_graphics_cmd_pool;
         alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        alloc_info.commandBufferCount = vkb_swapchain.image_count;
+        alloc_info.commandBufferCount = uint32_t(vk_frames_in_flight);
 
-        vk_cmd_graphics.resize(vkb_swapchain.image_count);
+        vk_cmd_graphics.resize(vk_frames_in_flight);
 
         if (vkAllocateCommandBuffers(vkb_device.device, &alloc_info,
                                      vk_cmd_graphics.data()) != VK_SUCCESS) {
@@ -333,9 +348,9 @@ Window::Window(const std::string& title, size_t width, size_t height,
         alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
         alloc_info.commandPool = vk_compute_cmd_pool;
         alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        alloc_info.commandBufferCount = vkb_swapchain.image_count;
+        alloc_info.commandBufferCount = uint32_t(vk_frames_in_flight);
 
-        vk_cmd_compute.resize(vkb_swapchain.image_count);
+        vk_cmd_compute.resize(vk_frames_in_flight);
 
         if (vkAllocateCommandBuffers(vkb_device.device, &alloc_info,
                                      vk_cmd_compute.data()) != VK_SUCCESS) {
@@ -345,26 +360,27 @@ Window::Window(const std::string& title, size_t width, size_t height,
         }
     }
 
-    vk_render_finished_semaphores.resize(vkb_swapchain.image_count);
-    vk_image_available_semaphores.resize(vkb_swapchain.image_count);
-    vk_graphics_flight_fences.resize(vkb_swapchain.image_count);
+    // Falls back to fences if the timelines cannot be created
+    if (vk_timeline_semaphores &&
+        (!graphics_timeline.Create() || !compute_timeline.Create() ||
+         !transfer_timeline.Create())) {
+        graphics_timeline.Destroy();
+        compute_timeline.Destroy();
+        transfer_timeline.Destroy();
+        vk_timeline_semaphores = false;
+    }
 
-    vk_compute_finished_semaphores.resize(vkb_swapchain.image_count);
-    vk_compute_flight_fences.resize(vkb_swapchain.image_count);
+    if (!uploader.Create()) {
+        DestroyWindow();
+        return;
+    }
 
-    for (uint32_t i = 0; i < vkb_swapchain.image_count; i++) {
-        VkSemaphoreCreateInfo semaphore_info{};
-        semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    VkSemaphoreCreateInfo semaphore_info{};
+    semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-        if (vkCreateSemaphore(vkb_device.device, &semaphore_info,
-                              vkb_device.allocation_callbacks,
-                              &vk_render_finished_semaphores[i]) !=
-            VK_SUCCESS) {
-            println("Could not create swapchain semaphore");
-            DestroyWindow();
-            return;
-        }
+    vk_image_available_semaphores.resize(vk_frames_in_flight);
 
+    for (size_t i = 0; i < vk_frames_in_flight; i++) {
         if (vkCreateSemaphore(vkb_device.device, &semaphore_info,
                               vkb_device.allocation_callbacks,
                               &vk_image_available_semaphores[i]) !=
@@ -373,7 +389,19 @@ Window::Window(const std::string& title, size_t width, size_t height,
             DestroyWindow();
             return;
         }
+    }
+
+    // The timelines replace these
+    if (vk_timeline_semaphores) {
+        return;
+    }
 
+    vk_graphics_flight_fences.resize(vk_frames_in_flight);
+
+    vk_compute_finished_semaphores.resize(vk_frames_in_flight);
+    vk_compute_flight_fences.resize(vk_frames_in_flight);
+
+    for (size_t i = 0; i < vk_frames_in_flight; i++) {
         VkFenceCreateInfo fence_info{};
         fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
         fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
@@ -412,6 +440,30 @@ Window::~Window() {
 
         vkDeviceWaitIdle(vkb_device.device);
 
+#ifndef CROW_NO_SHADERC
+        shader_hot_reloader.Stop();
+#endif
+        pipeline_manager.Destroy();
+        pipeline_layout_cache.Destroy();
+
+        pipeline_cache.Save();
+        pipeline_cache.Destroy();
+
+        shader_module_registry.Destroy();
+        render_graph.Destroy();
+        uploader.Destroy();
+
+        // Everything released at runtime, the device is idle so it can all
+        // go now
+        deletion_queue.Destroy();
+
+        upload_ring.Destroy();
+        memory_allocator.Destroy();
+
+        transfer_timeline.Destroy();
+        compute_timeline.Destroy();
+        graphics_timeline.Destroy();
+
         for (auto& fence : vk_compute_flight_fences) {
             vkDestroyFence(vkb_device.device, fence,
                            vkb_device.allocation_callbacks);
@@ -432,29 +484,15 @@ Window::~Window() {
                                vkb_device.allocation_callbacks);
         }
 
-        for (auto& semaphore : vk_render_finished_semaphores) {
-            vkDestroySemaphore(vkb_device.device, semaphore,
-                               vkb_device.allocation_callbacks);
-        }
+        command_recorder.Destroy();
 
         vkDestroyCommandPool(vkb_device.device, vk_compute_cmd_pool,
                              vkb_device.allocation_callbacks);
         vkDestroyCommandPool(vkb_device.device, vk_graphics_cmd_pool,
                              vkb_device.allocation_callbacks);
 
-        for (auto& framebuffer : vk_framebuffers) {
-            vkDestroyFramebuffer(vkb_device.device, framebuffer,
-                                 vkb_device.allocation_callbacks);
-        }
-
-        for (auto& render_pass : vk_render_passes) {
-            vkDestroyRenderPass(vkb_device.device, render_pass,
-                                vkb_device.allocation_callbacks);
-        }
-
-        vkb_swapchain.destroy_image_views(vk_image_views);
+        swapchain_manager.Destroy();
 
-        vkb::destroy_swapchain(vkb_swapchain);
         vkb::destroy_surface(vkb_instance, vk_surface);
         vkb::destroy_device(vkb_device);
         vkb::destroy_instance(vkb_instance);
@@ -507,7 +545,15 @@ void Window::SetFullscreen(bool fullscreen) {
 }
 
 void Window::Update() {
-    if (window) {
+    if (!window) {
+        return;
+    }
+
+    // No frames can start while minimized, so sleep until the window is
+    // restored instead of spinning through the frame loop
+    if (swapchain_manager.IsMinimized()) {
+        glfwWaitEvents();
+    } else {
         glfwPollEvents();
     }
 }